@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "arena.h"
+
+static __thread Arena arena;
+
+// allocation counters of the tracking wrappers
+static atomic_uint_fast64_t allocs;
+static atomic_uint_fast64_t reallocs;
+static atomic_uint_fast64_t frees;
+static atomic_uint_fast64_t bytes;
+static atomic_uint_fast64_t peak_bytes;
+
+Arena *arena_get(void) {
+    if (!arena.ready) {
+        mpz_inits(arena.gcd_a, arena.gcd_b, arena.gcd_t, NULL);
+        mpz_inits(arena.inv_r, arena.inv_r_prime, arena.inv_t, arena.inv_t_prime, arena.inv_q,
+            arena.inv_r_tmp, arena.inv_qr, arena.inv_t_tmp, arena.inv_qt, NULL);
+        mpz_init(arena.pow_o);
+        for (int i = 0; i < (1 << PROFILE_MAX_WINDOW); i += 1) {
+            mpz_init(arena.pow_table[i]);
+        }
+        mpz_inits(arena.prime_r, arena.prime_n_min_three, arena.prime_a, arena.prime_y,
+            arena.prime_n_min_one, arena.prime_two, NULL);
+        mpz_inits(arena.make_bits_two, arena.make_rand, NULL);
+        mpz_inits(arena.lcm_mul_ab, arena.lcm_pos_numerator, arena.lcm_num, arena.lcm_denom,
+            arena.lcm_divs, NULL);
+        mpz_init(arena.check_t);
+        arena.ready = true;
+    }
+    return &arena;
+}
+
+void arena_clear(void) {
+    if (arena.ready) {
+        mpz_clears(arena.gcd_a, arena.gcd_b, arena.gcd_t, NULL);
+        mpz_clears(arena.inv_r, arena.inv_r_prime, arena.inv_t, arena.inv_t_prime, arena.inv_q,
+            arena.inv_r_tmp, arena.inv_qr, arena.inv_t_tmp, arena.inv_qt, NULL);
+        mpz_clear(arena.pow_o);
+        for (int i = 0; i < (1 << PROFILE_MAX_WINDOW); i += 1) {
+            mpz_clear(arena.pow_table[i]);
+        }
+        mpz_clears(arena.prime_r, arena.prime_n_min_three, arena.prime_a, arena.prime_y,
+            arena.prime_n_min_one, arena.prime_two, NULL);
+        mpz_clears(arena.make_bits_two, arena.make_rand, NULL);
+        mpz_clears(arena.lcm_mul_ab, arena.lcm_pos_numerator, arena.lcm_num, arena.lcm_denom,
+            arena.lcm_divs, NULL);
+        mpz_clear(arena.check_t);
+        arena.ready = false;
+    }
+}
+
+// adds to the live byte count and raises the peak if needed
+static void count_bytes(size_t add, size_t sub) {
+    uint_fast64_t now = atomic_fetch_add(&bytes, add - sub) + add - sub;
+    uint_fast64_t peak = atomic_load(&peak_bytes);
+    while (now > peak && !atomic_compare_exchange_weak(&peak_bytes, &peak, now)) {
+    }
+}
+
+static void *track_alloc(size_t size) {
+    atomic_fetch_add(&allocs, 1);
+    count_bytes(size, 0);
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "ERROR OUT OF MEMORY.\n");
+        abort();
+    }
+    return ptr;
+}
+
+static void *track_realloc(void *ptr, size_t old_size, size_t new_size) {
+    atomic_fetch_add(&reallocs, 1);
+    count_bytes(new_size, old_size);
+    ptr = realloc(ptr, new_size);
+    if (ptr == NULL) {
+        fprintf(stderr, "ERROR OUT OF MEMORY.\n");
+        abort();
+    }
+    return ptr;
+}
+
+static void track_free(void *ptr, size_t size) {
+    atomic_fetch_add(&frees, 1);
+    count_bytes(0, size);
+    free(ptr);
+}
+
+void arena_track(void) {
+    mp_set_memory_functions(track_alloc, track_realloc, track_free);
+}
+
+void arena_print_stats(FILE *statfile) {
+    fprintf(statfile, "gmp allocs = %lu\n", (uint64_t) atomic_load(&allocs));
+    fprintf(statfile, "gmp reallocs = %lu\n", (uint64_t) atomic_load(&reallocs));
+    fprintf(statfile, "gmp frees = %lu\n", (uint64_t) atomic_load(&frees));
+    fprintf(statfile, "gmp live bytes = %lu\n", (uint64_t) atomic_load(&bytes));
+    fprintf(statfile, "gmp peak bytes = %lu\n", (uint64_t) atomic_load(&peak_bytes));
+}
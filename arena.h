@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "profile.h"
+
+//
+// Per-thread scratch temporaries for the number theory hot path.
+//
+// Every function gets its own slots so that nested calls (is_prime calling pow_mod,
+// lcm calling gcd) never share a temporary. The slots are initialized the first time
+// a thread asks for them and keep their limbs between calls, so once they have grown
+// to the key size no further allocations happen.
+//
+typedef struct {
+    bool ready;
+    // gcd
+    mpz_t gcd_a, gcd_b, gcd_t;
+    // mod_inverse
+    mpz_t inv_r, inv_r_prime, inv_t, inv_t_prime, inv_q, inv_r_tmp, inv_qr, inv_t_tmp, inv_qt;
+    // pow_mod
+    mpz_t pow_o, pow_table[1 << PROFILE_MAX_WINDOW];
+    // is_prime
+    mpz_t prime_r, prime_n_min_three, prime_a, prime_y, prime_n_min_one, prime_two;
+    // make_prime
+    mpz_t make_bits_two, make_rand;
+    // lcm
+    mpz_t lcm_mul_ab, lcm_pos_numerator, lcm_num, lcm_denom, lcm_divs;
+    // the check backend
+    mpz_t check_t;
+} Arena;
+
+//
+// Returns the calling thread's arena, initializing it on first use.
+// The number theory functions borrow their temporaries from it instead of allocating
+// new ones on every call.
+//
+Arena *arena_get(void);
+
+//
+// Frees the calling thread's arena. Must be called by a thread before it exits
+// if it has used any number theory functions.
+//
+void arena_clear(void);
+
+//
+// Routes all GMP allocations through counting wrappers.
+// Must be called before any mpz_t is initialized.
+//
+void arena_track(void);
+
+//
+// Prints the GMP allocation counts gathered since arena_track was called.
+//
+// statfile: open and writable file stream
+//
+void arena_print_stats(FILE *statfile);
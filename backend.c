@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "backend.h"
+#include "numtheory.h"
+
+static void gmp_gcd(mpz_t g, const mpz_t a, const mpz_t b) {
+    mpz_gcd(g, a, b);
+}
+
+// mpz_invert leaves o undefined without an inverse, the reference code returns 0
+static void gmp_mod_inverse(mpz_t o, const mpz_t a, const mpz_t n) {
+    if (mpz_invert(o, a, n) == 0) {
+        mpz_set_ui(o, 0);
+    }
+}
+
+static void gmp_pow_mod(mpz_t o, const mpz_t a, const mpz_t d, const mpz_t n) {
+    mpz_powm(o, a, d, n);
+}
+
+// mpz_powm_sec only takes odd moduli and positive exponents
+static void gmp_sec_pow_mod(mpz_t o, const mpz_t a, const mpz_t d, const mpz_t n) {
+    if (mpz_odd_p(n) && mpz_sgn(d) > 0) {
+        mpz_powm_sec(o, a, d, n);
+    } else {
+        mpz_powm(o, a, d, n);
+    }
+}
+
+static bool gmp_is_prime(const mpz_t n, uint64_t iters) {
+    return mpz_probab_prime_p(n, (int) iters) > 0;
+}
+
+// reports a disagreement between the two engines and stops before bad output is written
+static void check_failed(const char *what, const mpz_t a, const mpz_t b) {
+    gmp_fprintf(stderr, "ERROR BACKEND MISMATCH IN %s: ref = %Zx, gmp = %Zx\n", what, a, b);
+    abort();
+}
+
+// GMP goes first since the result may alias an input, as in is_prime's squarings
+static void check_gcd(mpz_t g, const mpz_t a, const mpz_t b) {
+    Arena *arena = arena_get();
+    mpz_gcd(arena->check_t, a, b);
+    gcd(g, a, b);
+    if (mpz_cmpabs(g, arena->check_t) != 0) {
+        check_failed("gcd", g, arena->check_t);
+    }
+}
+
+static void check_mod_inverse(mpz_t o, const mpz_t a, const mpz_t n) {
+    Arena *arena = arena_get();
+    gmp_mod_inverse(arena->check_t, a, n);
+    mod_inverse(o, a, n);
+    if (mpz_cmp(o, arena->check_t) != 0) {
+        check_failed("mod_inverse", o, arena->check_t);
+    }
+}
+
+// fast's pow_mod is GMP's own, so the reference pow_mod is the one checked against it
+static void check_pow_mod(mpz_t o, const mpz_t a, const mpz_t d, const mpz_t n) {
+    Arena *arena = arena_get();
+    mpz_powm(arena->check_t, a, d, n);
+    pow_mod(o, a, d, n);
+    if (mpz_cmp(o, arena->check_t) != 0) {
+        check_failed("pow_mod", o, arena->check_t);
+    }
+}
+
+// both tests are probabilistic, but a prime must pass both and a composite that one of
+// them accepts is far beyond chance
+static bool check_is_prime(const mpz_t n, uint64_t iters) {
+    bool ref = is_prime(n, iters);
+    bool gmp = gmp_is_prime(n, iters);
+    if (ref != gmp) {
+        gmp_fprintf(stderr, "ERROR BACKEND MISMATCH IN is_prime(%Zx): ref = %d, gmp = %d\n", n,
+            ref, gmp);
+        abort();
+    }
+    return ref;
+}
+
+static const Backend backends[] = {
+    { "ref", gcd, mod_inverse, pow_mod, is_prime },
+    { "fast", gcd, mod_inverse, gmp_pow_mod, is_prime },
+    { "gmp", gmp_gcd, gmp_mod_inverse, gmp_pow_mod, gmp_is_prime },
+    { "gmp-sec", gmp_gcd, gmp_mod_inverse, gmp_sec_pow_mod, gmp_is_prime },
+    { "check", check_gcd, check_mod_inverse, check_pow_mod, check_is_prime },
+};
+
+#define BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+const Backend *backend = &backends[1];
+
+bool backend_select(const char *name) {
+    if (name == NULL) {
+        name = getenv("SS_BACKEND");
+        if (name == NULL) {
+            return true;
+        }
+    }
+
+    for (size_t i = 0; i < BACKENDS; i += 1) {
+        if (strcmp(backends[i].name, name) == 0) {
+            backend = &backends[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void backend_list(FILE *listfile) {
+    for (size_t i = 0; i < BACKENDS; i += 1) {
+        fprintf(listfile, "%s%s", i == 0 ? "" : " ", backends[i].name);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// A set of arithmetic routines the SS code calls through.
+//
+// Backends:
+//  ref:     the hand written gcd, mod_inverse, pow_mod and is_prime of numtheory.c
+//  fast:    ref, with pow_mod running on mpz_powm (default)
+//  gmp:     mpz_gcd, mpz_invert, mpz_powm and mpz_probab_prime_p
+//  gmp-sec: gmp, with the side channel silent mpz_powm_sec for odd moduli
+//  check:   runs ref and gmp side by side and aborts on the first mismatch
+//
+typedef struct {
+    const char *name;
+    void (*gcd)(mpz_t g, const mpz_t a, const mpz_t b);
+    void (*mod_inverse)(mpz_t o, const mpz_t a, const mpz_t n);
+    void (*pow_mod)(mpz_t o, const mpz_t a, const mpz_t d, const mpz_t n);
+    bool (*is_prime)(const mpz_t n, uint64_t iters);
+} Backend;
+
+//
+// The backend in use. Starts out as "fast".
+//
+extern const Backend *backend;
+
+//
+// Selects the backend by name.
+//
+// name: backend to use, or NULL to use $SS_BACKEND if it is set
+//
+// Returns false, keeping the current backend, if the name is unknown.
+//
+bool backend_select(const char *name);
+
+//
+// Prints the names of all backends separated by spaces.
+//
+void backend_list(FILE *listfile);
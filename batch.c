@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "path.h"
+#include "pool.h"
+#include "profile.h"
+#include "ss.h"
+
+// ranges of one file in flight per worker thread; enough that a thief finds work while the
+// owner is busy, few enough that the output waiting to be written stays bounded
+#define BATCH_WINDOW 2
+
+// the key and settings shared read-only by every task of a run
+typedef struct {
+    Pool *pool;
+    bool decrypt;
+    mpz_srcptr n; // public key when encrypting
+    mpz_srcptr d; // private exponent when decrypting
+    mpz_srcptr pq; // private modulus when decrypting
+    size_t k; // block size in bytes, including the 0xFF padding byte
+    size_t chunk; // bytes of input per range task
+    size_t window; // most ranges of one file queued or held in memory at once
+    atomic_bool *failed; // set once any file of the run fails
+    dev_t out_dev; // the output directory, skipped if it lies inside the input tree
+    ino_t out_ino;
+} BatchKey;
+
+// one file being processed, shared by its range tasks
+typedef struct {
+    const BatchKey *key;
+    char *inpath;
+    int outfd;
+    size_t ranges; // number of range tasks
+    size_t next; // next range to write out
+    size_t queued; // ranges submitted so far, at most next + window
+    char **parts; // finished output of range i in slot i % window, NULL until done
+    size_t *part_lens;
+    bool failed; // set once a range could not be read or written
+    pthread_mutex_t lock;
+} FileJob;
+
+// one range of a file
+typedef struct {
+    FileJob *job;
+    size_t index;
+    off_t start;
+    off_t end;
+} RangeTask;
+
+// a file waiting to be opened and split into ranges
+typedef struct {
+    const BatchKey *key;
+    char *inpath;
+    char *outpath;
+} FileTask;
+
+// appends len bytes to a growing buffer
+static void buf_append(char **buf, size_t *len, size_t *cap, const void *data, size_t n) {
+    if (*len + n > *cap) {
+        *cap = (*len + n) * 2;
+        *buf = (char *) realloc(*buf, *cap);
+    }
+    memcpy(*buf + *len, data, n);
+    *len += n;
+}
+
+// encrypts the blocks of one range, producing the same lines ss_encrypt_file does
+// Returns false if the range could not be read.
+static bool encrypt_range(const BatchKey *key, const char *path, off_t start, off_t end,
+    char **out_buf, size_t *out_len) {
+    size_t len = 0, cap = 0;
+    char *out = NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR %s CANNOT BE OPENED.\n", path);
+        return false;
+    }
+
+    uint8_t *arr_block = (uint8_t *) calloc(key->k, sizeof(uint8_t));
+    arr_block[0] = 0xFF;
+    char *hex = (char *) malloc(mpz_sizeinbase(key->n, 16) + 2);
+
+    mpz_t c, m;
+    mpz_inits(c, m, NULL);
+
+    bool ok = true;
+    for (off_t pos = start; pos < end;) {
+        ssize_t j = pread(fd, arr_block + 1, key->k - 1, pos);
+        if (j < 0 && errno == EINTR) {
+            continue;
+        }
+        if (j < 0) {
+            fprintf(stderr, "ERROR READING %s: %s\n", path, strerror(errno));
+            ok = false;
+        }
+        if (j <= 0) {
+            break;
+        }
+        size_t hex_len = ss_encrypt_block(hex, arr_block, j + 1, key->n, c, m);
+        buf_append(&out, &len, &cap, hex, hex_len);
+        buf_append(&out, &len, &cap, "\n", 1);
+        pos += j;
+    }
+
+    mpz_clears(c, m, NULL);
+    free(hex);
+    free(arr_block);
+    close(fd);
+    *out_buf = out;
+    *out_len = len;
+    return ok;
+}
+
+// decrypts every line that starts inside the range, producing what ss_decrypt_file does
+// Returns false if the range could not be read.
+static bool decrypt_range(const BatchKey *key, const char *path, off_t start, off_t end,
+    char **out_buf, size_t *out_len) {
+    size_t len = 0, cap = 0;
+    char *out = NULL;
+
+    FILE *infile = fopen(path, "r");
+    if (infile == NULL) {
+        fprintf(stderr, "ERROR %s CANNOT BE OPENED.\n", path);
+        return false;
+    }
+
+    // a line that began in the previous range belongs to that range
+    off_t pos = start;
+    if (start > 0) {
+        if (fseeko(infile, start - 1, SEEK_SET) != 0) {
+            fprintf(stderr, "ERROR READING %s.\n", path);
+            fclose(infile);
+            return false;
+        }
+        int ch;
+        pos = start - 1;
+        while ((ch = fgetc(infile)) != EOF) {
+            pos += 1;
+            if (ch == '\n') {
+                break;
+            }
+        }
+    }
+
+    uint8_t *arr_block = (uint8_t *) calloc(mpz_sizeinbase(key->pq, 256) + 1, sizeof(uint8_t));
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len;
+
+    mpz_t c, m;
+    mpz_inits(c, m, NULL);
+
+    while (pos < end && (line_len = getline(&line, &line_cap, infile)) > 0) {
+        pos += line_len;
+        size_t j = ss_decrypt_block(arr_block, line, line_len, key->d, key->pq, c, m);
+        if (j > 0) {
+            buf_append(&out, &len, &cap, arr_block + 1, j);
+        }
+    }
+
+    bool ok = !ferror(infile);
+    if (!ok) {
+        fprintf(stderr, "ERROR READING %s.\n", path);
+    }
+
+    mpz_clears(c, m, NULL);
+    free(line);
+    free(arr_block);
+    fclose(infile);
+    *out_buf = out;
+    *out_len = len;
+    return ok;
+}
+
+// writes all of buf to fd, returning false on a write error
+static bool write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t w = write(fd, buf, len);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "ERROR WRITING OUTPUT: %s\n", strerror(errno));
+            return false;
+        }
+        buf += w;
+        len -= w;
+    }
+    return true;
+}
+
+// frees a file job once all of its ranges are written, recording a failed file in the run
+static void job_finish(FileJob *job) {
+    if (close(job->outfd) != 0) {
+        fprintf(stderr, "ERROR WRITING OUTPUT: %s\n", strerror(errno));
+        job->failed = true;
+    }
+    if (job->failed) {
+        atomic_store(job->key->failed, true);
+    }
+    pthread_mutex_destroy(&job->lock);
+    free(job->parts);
+    free(job->part_lens);
+    free(job->inpath);
+    free(job);
+}
+
+static void range_task(void *arg);
+
+// queues ranges [from, to) of a file back to front, so the owner works from the start of the
+// window while thieves take its later ranges
+static void job_queue(const BatchKey *key, FileJob *job, size_t from, size_t to) {
+    for (size_t i = to; i-- > from;) {
+        RangeTask *range = (RangeTask *) malloc(sizeof(RangeTask));
+        range->job = job;
+        range->index = i;
+        range->start = (off_t) (i * key->chunk);
+        range->end = (off_t) ((i + 1) * key->chunk);
+        pool_submit(key->pool, range_task, range);
+    }
+}
+
+// processes one range, writes out every finished range that is next in line and
+// queues the ranges that moved into the window
+static void range_task(void *arg) {
+    RangeTask *task = (RangeTask *) arg;
+    FileJob *job = task->job;
+    const BatchKey *key = job->key;
+
+    size_t len = 0;
+    char *out = NULL;
+    bool ok = key->decrypt
+                  ? decrypt_range(key, job->inpath, task->start, task->end, &out, &len)
+                  : encrypt_range(key, job->inpath, task->start, task->end, &out, &len);
+    // an empty or failed range still has to count as finished
+    if (out == NULL) {
+        out = (char *) malloc(1);
+    }
+
+    // ranges finish in any order but are written in order, and nothing more is written
+    // once a range of the file has failed
+    size_t window = key->window;
+    pthread_mutex_lock(&job->lock);
+    job->failed = job->failed || !ok;
+    job->parts[task->index % window] = out;
+    job->part_lens[task->index % window] = len;
+    while (job->next < job->ranges && job->parts[job->next % window] != NULL) {
+        size_t slot = job->next % window;
+        if (!job->failed) {
+            job->failed = !write_all(job->outfd, job->parts[slot], job->part_lens[slot]);
+        }
+        free(job->parts[slot]);
+        job->parts[slot] = NULL;
+        job->next += 1;
+    }
+    bool done = job->next == job->ranges;
+
+    // every range written out frees a place in the window for the next one
+    size_t from = job->queued;
+    size_t to = job->next + window < job->ranges ? job->next + window : job->ranges;
+    job->queued = to;
+    pthread_mutex_unlock(&job->lock);
+
+    // the job may be finished and freed by another range as soon as the lock is dropped,
+    // unless new ranges were reserved above, which keep it alive until they are written
+    if (done) {
+        job_finish(job);
+    } else if (from < to) {
+        job_queue(key, job, from, to);
+    }
+    free(task);
+}
+
+// opens one file and splits it into range tasks on this worker's deque
+static void file_task(void *arg) {
+    FileTask *task = (FileTask *) arg;
+    const BatchKey *key = task->key;
+
+    struct stat st;
+    int outfd = -1;
+    if (stat(task->inpath, &st) != 0) {
+        fprintf(stderr, "ERROR %s CANNOT BE OPENED.\n", task->inpath);
+        atomic_store(key->failed, true);
+    } else if ((outfd = open(task->outpath, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0) {
+        fprintf(stderr, "ERROR %s CANNOT BE OPENED.\n", task->outpath);
+        atomic_store(key->failed, true);
+    }
+
+    if (outfd >= 0) {
+        size_t ranges = (st.st_size + key->chunk - 1) / key->chunk;
+        if (ranges == 0) {
+            if (close(outfd) != 0) {
+                fprintf(stderr, "ERROR WRITING OUTPUT: %s\n", strerror(errno));
+                atomic_store(key->failed, true);
+            }
+        } else {
+            FileJob *job = (FileJob *) calloc(1, sizeof(FileJob));
+            job->key = key;
+            job->inpath = task->inpath;
+            task->inpath = NULL;
+            job->outfd = outfd;
+            job->ranges = ranges;
+            job->parts = (char **) calloc(key->window, sizeof(char *));
+            job->part_lens = (size_t *) calloc(key->window, sizeof(size_t));
+            pthread_mutex_init(&job->lock, NULL);
+
+            // only the first window of ranges is queued, the rest follow as ranges are
+            // written, so a large file never holds more than a window of output in memory
+            job->queued = ranges < key->window ? ranges : key->window;
+            job_queue(key, job, 0, job->queued);
+        }
+    }
+
+    free(task->inpath);
+    free(task->outpath);
+    free(task);
+}
+
+// queues every regular file under indir, mirroring the tree into outdir
+// Symbolic links to files are followed, symbolic links to directories are not, so a link
+// cannot lead the walk around in a loop.
+// Returns false if any part of the tree could not be read or created.
+static bool walk_dir(const BatchKey *key, const char *indir, const char *outdir) {
+    DIR *dir = opendir(indir);
+    if (dir == NULL) {
+        fprintf(stderr, "ERROR %s CANNOT BE OPENED.\n", indir);
+        return false;
+    }
+    if (mkdir(outdir, 0700) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR %s CANNOT BE CREATED.\n", outdir);
+        closedir(dir);
+        return false;
+    }
+
+    bool ok = true;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        char *inpath = path_join(indir, entry->d_name);
+        char *outpath = path_join(outdir, entry->d_name);
+        struct stat st;
+        if (lstat(inpath, &st) != 0) {
+            fprintf(stderr, "ERROR %s CANNOT BE OPENED.\n", inpath);
+            ok = false;
+        } else if (S_ISDIR(st.st_mode)) {
+            if (st.st_dev != key->out_dev || st.st_ino != key->out_ino) {
+                ok = walk_dir(key, inpath, outpath) && ok;
+            }
+        } else if (S_ISREG(st.st_mode)
+                   || (S_ISLNK(st.st_mode) && stat(inpath, &st) == 0 && S_ISREG(st.st_mode))) {
+            FileTask *task = (FileTask *) malloc(sizeof(FileTask));
+            task->key = key;
+            task->inpath = inpath;
+            task->outpath = outpath;
+            pool_submit(key->pool, file_task, task);
+            continue;
+        }
+        free(inpath);
+        free(outpath);
+    }
+
+    closedir(dir);
+    return ok;
+}
+
+// creates outdir, walks indir into it on a pool of "threads" threads and waits for every file
+static bool batch_run(BatchKey *key, const char *indir, const char *outdir, uint64_t threads) {
+    // the output directory may sit inside the input tree, the walk must not descend into it
+    struct stat in_st, out_st;
+    if (mkdir(outdir, 0700) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR %s CANNOT BE CREATED.\n", outdir);
+        return false;
+    }
+    if (stat(indir, &in_st) != 0) {
+        fprintf(stderr, "ERROR %s CANNOT BE OPENED.\n", indir);
+        return false;
+    }
+    if (stat(outdir, &out_st) != 0) {
+        fprintf(stderr, "ERROR %s CANNOT BE OPENED.\n", outdir);
+        return false;
+    }
+    if (in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) {
+        fprintf(stderr, "ERROR -O MUST NOT BE THE DIRECTORY GIVEN TO -r.\n");
+        return false;
+    }
+    key->out_dev = out_st.st_dev;
+    key->out_ino = out_st.st_ino;
+
+    key->window = BATCH_WINDOW * (threads < 1 ? 1 : threads);
+    key->pool = pool_create(threads);
+    atomic_bool failed = false;
+    key->failed = &failed;
+
+    bool ok = walk_dir(key, indir, outdir);
+
+    pool_delete(&key->pool);
+    return ok && !atomic_load(&failed);
+}
+
+bool batch_encrypt_dir(const char *indir, const char *outdir, const mpz_t n, uint64_t threads) {
+    BatchKey key = { 0 };
+    key.n = n;
+    // block size k as calculated by ss_encrypt_file
+    key.k = (mpz_sizeinbase(n, 2) / 2 - 1) / 8;
+    key.chunk = profile.batch * (key.k - 1);
+    return batch_run(&key, indir, outdir, threads);
+}
+
+bool batch_decrypt_dir(
+    const char *indir, const char *outdir, const mpz_t d, const mpz_t pq, uint64_t threads) {
+    BatchKey key = { 0 };
+    key.decrypt = true;
+    key.d = d;
+    key.pq = pq;
+    // block size k as calculated by ss_decrypt_file, and the rough length of a ciphertext line
+    key.k = (mpz_sizeinbase(pq, 2) - 1) / 8;
+    key.chunk = profile.batch * (mpz_sizeinbase(pq, 16) * 3 / 2 + 1);
+    return batch_run(&key, indir, outdir, threads);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Encrypt every regular file under a directory tree
+//
+// Provides:
+//  fills outdir with an encrypted copy of each file in indir, under the same relative path
+//
+// Each file is a task on a work-stealing thread pool that splits the file into ranges of
+// profile.batch blocks, so small files keep all threads busy and a large file is spread over all of them.
+// The output of each file is the same as ss_encrypt_file would write.
+// outdir may lie inside indir, the walk skips it. Symbolic links to files are followed,
+// symbolic links to directories are not.
+//
+// Requires:
+//  indir: readable directory
+//  outdir: directory to write into, created if missing
+//  n: public exponent and modulus
+//  threads: number of worker threads
+//
+// Returns false if any file or directory of the tree could not be read or written. The
+// other files are still processed.
+//
+bool batch_encrypt_dir(const char *indir, const char *outdir, const mpz_t n, uint64_t threads);
+
+//
+// Decrypt every regular file under a directory tree
+//
+// Provides:
+//  fills outdir with a decrypted copy of each file in indir, under the same relative path
+//
+// The tree is walked as in batch_encrypt_dir.
+//
+// Requires:
+//  indir: readable directory of files made by ss_encrypt_file or batch_encrypt_dir
+//  outdir: directory to write into, created if missing
+//  d: private exponent
+//  pq: private modulus
+//  threads: number of worker threads
+//
+// Returns false if any file or directory of the tree could not be read or written. The
+// other files are still processed.
+//
+bool batch_decrypt_dir(
+    const char *indir, const char *outdir, const mpz_t d, const mpz_t pq, uint64_t threads);
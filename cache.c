@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "cache.h"
+#include "hash.h"
+
+// number of locks the slots are striped over
+#define CACHE_LOCKS 64
+
+// bookkeeping of one slot, its key and value live in the data area
+typedef struct {
+    uint64_t hash;
+    uint64_t key_len; // 0 for an empty slot
+    uint64_t value_len;
+} Slot;
+
+struct Cache {
+    uint64_t entries;
+    uint64_t max_key;
+    uint64_t max_value;
+    Slot *slots;
+    uint8_t *data; // entries * (max_key + max_value) bytes
+    pthread_mutex_t locks[CACHE_LOCKS];
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+    atomic_uint_fast64_t evictions;
+    atomic_uint_fast64_t used; // slots holding an entry
+};
+
+// hashes a byte string eight bytes at a time
+static uint64_t cache_hash(const uint8_t *key, uint64_t len) {
+    uint64_t h = len * 0x9E3779B97F4A7C15ULL;
+    uint64_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, key + i, 8);
+        h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 32;
+    }
+    h = hash_bytes(h, key + i, len - i);
+
+    // finalize so the low bits used for the slot depend on every input bit
+    return hash_mix(h);
+}
+
+Cache *cache_create(uint64_t entries, uint64_t max_key, uint64_t max_value) {
+    if (entries < 1) {
+        entries = 1;
+    }
+
+    Cache *cache = (Cache *) calloc(1, sizeof(Cache));
+    cache->entries = entries;
+    cache->max_key = max_key;
+    cache->max_value = max_value;
+    cache->slots = (Slot *) calloc(entries, sizeof(Slot));
+    cache->data = (uint8_t *) malloc(entries * (max_key + max_value));
+    for (int i = 0; i < CACHE_LOCKS; i += 1) {
+        pthread_mutex_init(&cache->locks[i], NULL);
+    }
+    return cache;
+}
+
+void cache_delete(Cache **cache) {
+    if (*cache == NULL) {
+        return;
+    }
+    for (int i = 0; i < CACHE_LOCKS; i += 1) {
+        pthread_mutex_destroy(&(*cache)->locks[i]);
+    }
+    free((*cache)->slots);
+    free((*cache)->data);
+    free(*cache);
+    *cache = NULL;
+}
+
+bool cache_get(Cache *cache, const uint8_t *key, uint64_t key_len, uint8_t *value,
+    uint64_t *value_len) {
+    uint64_t hash = cache_hash(key, key_len);
+    uint64_t i = hash % cache->entries;
+    Slot *slot = &cache->slots[i];
+    uint8_t *data = cache->data + i * (cache->max_key + cache->max_value);
+
+    bool hit = false;
+    pthread_mutex_lock(&cache->locks[i % CACHE_LOCKS]);
+    if (slot->key_len == key_len && slot->hash == hash && memcmp(data, key, key_len) == 0) {
+        memcpy(value, data + cache->max_key, slot->value_len);
+        *value_len = slot->value_len;
+        hit = true;
+    }
+    pthread_mutex_unlock(&cache->locks[i % CACHE_LOCKS]);
+
+    atomic_fetch_add(hit ? &cache->hits : &cache->misses, 1);
+    return hit;
+}
+
+void cache_put(Cache *cache, const uint8_t *key, uint64_t key_len, const uint8_t *value,
+    uint64_t value_len) {
+    if (key_len == 0 || key_len > cache->max_key || value_len > cache->max_value) {
+        return;
+    }
+
+    uint64_t hash = cache_hash(key, key_len);
+    uint64_t i = hash % cache->entries;
+    Slot *slot = &cache->slots[i];
+    uint8_t *data = cache->data + i * (cache->max_key + cache->max_value);
+
+    pthread_mutex_lock(&cache->locks[i % CACHE_LOCKS]);
+    if (slot->key_len == 0) {
+        atomic_fetch_add(&cache->used, 1);
+    } else {
+        atomic_fetch_add(&cache->evictions, 1);
+    }
+    slot->hash = hash;
+    slot->key_len = key_len;
+    slot->value_len = value_len;
+    memcpy(data, key, key_len);
+    memcpy(data + cache->max_key, value, value_len);
+    pthread_mutex_unlock(&cache->locks[i % CACHE_LOCKS]);
+}
+
+void cache_print_stats(const Cache *cache, const char *name, FILE *statfile) {
+    uint64_t hits = atomic_load(&cache->hits);
+    uint64_t misses = atomic_load(&cache->misses);
+    uint64_t lookups = hits + misses;
+    uint64_t bytes = sizeof(Cache) + cache->entries * (sizeof(Slot) + cache->max_key + cache->max_value);
+
+    fprintf(statfile, "%s cache hits = %lu of %lu (%.1f%%)\n", name, hits, lookups,
+        lookups == 0 ? 0.0 : 100.0 * hits / lookups);
+    fprintf(statfile, "%s cache evictions = %lu\n", name, (uint64_t) atomic_load(&cache->evictions));
+    fprintf(statfile, "%s cache entries = %lu of %lu\n", name, (uint64_t) atomic_load(&cache->used),
+        cache->entries);
+    fprintf(statfile, "%s cache bytes = %lu\n", name, bytes);
+}
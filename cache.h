@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Cache Cache;
+
+//
+// Creates a bounded, thread-safe memoization cache from byte strings to byte strings.
+// The cache is direct mapped: each key hashes to one slot, and a new key replaces whatever
+// the slot held. All memory is allocated up front, entries * (max_key + max_value) bytes
+// plus bookkeeping, so lookups and insertions never allocate.
+//
+// entries: number of slots
+// max_key: longest key that will be stored
+// max_value: longest value that will be stored
+//
+Cache *cache_create(uint64_t entries, uint64_t max_key, uint64_t max_value);
+
+//
+// Frees a cache and sets the pointer to NULL.
+//
+void cache_delete(Cache **cache);
+
+//
+// Looks up a key.
+//
+// Provides:
+//  value: the stored value, if found
+//  value_len: its length
+//
+// Requires:
+//  value: room for max_value bytes
+//
+// Returns true on a hit.
+//
+bool cache_get(Cache *cache, const uint8_t *key, uint64_t key_len, uint8_t *value,
+    uint64_t *value_len);
+
+//
+// Stores a value for a key, replacing the slot's previous entry.
+// Keys or values longer than the limits given to cache_create are not stored.
+//
+void cache_put(Cache *cache, const uint8_t *key, uint64_t key_len, const uint8_t *value,
+    uint64_t value_len);
+
+//
+// Prints the hit rate and memory use of a cache.
+//
+// name: label for the cache in the output
+// statfile: open and writable file stream
+//
+void cache_print_stats(const Cache *cache, const char *name, FILE *statfile);
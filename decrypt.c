@@ -1,5 +1,10 @@
+#include "arena.h"
+#include "backend.h"
+#include "batch.h"
 #include "numtheory.h"
+#include "profile.h"
 #include "randstate.h"
+#include "shard.h"
 #include "ss.h"
 
 #include <gmp.h>
@@ -8,6 +13,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <getopt.h>
+
+// seconds between checkpoints when --resume is given without --checkpoint
+#define CHECKPOINT_INTERVAL 30
+
+// long options without a short form
+enum { OPT_CHECKPOINT = 256, OPT_RESUME, OPT_SHARD, OPT_MERGE };
 
 void usage(char *exec) {
     fprintf(stderr,
@@ -17,36 +29,146 @@ void usage(char *exec) {
         "\n"
         "USAGE\n"
         "   %s [OPTIONS]\n"
+        "   %s --merge -i manifest [-o outfile] part0 part1 ...\n"
         "\n"
         "OPTIONS\n"
         "   -h              Display program help and usage.\n"
         "   -v              Display verbose program output.\n"
         "   -i infile       Input file of data to decrypt (default: stdin).\n"
         "   -o outfile      Output file for decrypted data (default: stdout).\n"
-        "   -n pvfile       Private key file (default: ss.priv).\n",
-        exec);
+        "   -n pvfile       Private key file (default: ss.priv).\n"
+        "   -r indir        Decrypt every file under indir (requires -O).\n"
+        "   -O outdir       Output directory for -r.\n"
+        "   -t threads      Worker threads for -r (default: from profile, else online CPUs).\n"
+        "   -p profile      Tuning profile written by ss-tune (default: ~/.ss_tune).\n"
+        "   -B backend      Arithmetic backend: ref, fast, gmp, gmp-sec or check\n"
+        "                   (default: $SS_BACKEND, else fast).\n"
+        "   -c entries      Cache up to this many repeated blocks (default: 0, off).\n"
+        "   --checkpoint secs\n"
+        "                   Record progress in outfile.ckpt every secs seconds (requires -o).\n"
+        "   --resume        Continue an interrupted run from outfile.ckpt, checkpointing\n"
+        "                   every %d seconds unless --checkpoint is given (requires -i and -o).\n"
+        "   --shard index   Decrypt only this shard of the manifest given with -i.\n"
+        "   --merge         Join the decrypted shards of the manifest given with -i, listed\n"
+        "                   in shard order after the options, into outfile. No key is needed.\n",
+        exec, exec, CHECKPOINT_INTERVAL);
 }
 
-#define OPTIONS "i:o:n:vh"
+#define OPTIONS "i:o:n:r:O:t:p:c:B:vh"
+
+static const struct option long_options[] = {
+    { "checkpoint", required_argument, NULL, OPT_CHECKPOINT },
+    { "resume", no_argument, NULL, OPT_RESUME },
+    { "shard", required_argument, NULL, OPT_SHARD },
+    { "merge", no_argument, NULL, OPT_MERGE },
+    { NULL, 0, NULL, 0 },
+};
 
 int main(int argc, char **argv) {
     int opt = 0;
     FILE *infile = NULL;
+    char *inname = NULL;
     FILE *outfile = NULL;
+    char *outname = NULL;
     FILE *pvfile = fopen("ss.priv", "r");
+    char *indir = NULL;
+    char *outdir = NULL;
+    uint64_t threads = 0;
+    char *profile_file = NULL;
+    char *backend_name = NULL;
+    uint64_t cache_entries = 0;
+    uint64_t checkpoint = 0;
+    bool resume = false;
+    bool shard_flag = false;
+    uint64_t shard = 0;
+    bool merge = false;
     bool verbose_flag = false;
 
-    while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+    while ((opt = getopt_long(argc, argv, OPTIONS, long_options, NULL)) != -1) {
         switch (opt) {
-        case 'i': infile = fopen(optarg, "r"); break;
-        case 'o': outfile = fopen(optarg, "w"); break;
+        case 'i':
+            inname = optarg;
+            infile = fopen(optarg, "r");
+            break;
+        case 'o': outname = optarg; break;
         case 'n': pvfile = fopen(optarg, "r"); break;
+        case 'r': indir = optarg; break;
+        case 'O': outdir = optarg; break;
+        case 't': threads = strtoul(optarg, NULL, 10); break;
+        case 'p': profile_file = optarg; break;
+        case 'B': backend_name = optarg; break;
+        case 'c': cache_entries = strtoul(optarg, NULL, 10); break;
+        case OPT_CHECKPOINT: checkpoint = strtoul(optarg, NULL, 10); break;
+        case OPT_RESUME: resume = true; break;
+        case OPT_SHARD:
+            shard_flag = true;
+            shard = strtoul(optarg, NULL, 10);
+            break;
+        case OPT_MERGE: merge = true; break;
         case 'v': verbose_flag = true; break;
         case 'h': usage(argv[0]); return 0;
         default: usage(argv[0]); return 0;
         }
     }
 
+    // switch arithmetic engines, -B overrides $SS_BACKEND
+    if (!backend_select(backend_name)) {
+        fprintf(stderr, "ERROR UNKNOWN BACKEND, CHOOSE ONE OF: ");
+        backend_list(stderr);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    // count GMP allocations before any number is created
+    if (verbose_flag == true) {
+        arena_track();
+    }
+
+    // directory mode needs both directories
+    if ((indir == NULL) != (outdir == NULL)) {
+        fprintf(stderr, "ERROR -r AND -O MUST BE USED TOGETHER.\n");
+        return 1;
+    }
+
+    // checkpoints describe one input and one output file
+    if ((checkpoint > 0 || resume) && (outname == NULL || indir != NULL)) {
+        fprintf(stderr, "ERROR --checkpoint AND --resume NEED -o AND DO NOT WORK WITH -r.\n");
+        return 1;
+    }
+    if (resume && infile == NULL) {
+        fprintf(stderr, "ERROR --resume NEEDS -i.\n");
+        return 1;
+    }
+    // shards are found through the manifest named by -i
+    if ((shard_flag || merge) && (inname == NULL || indir != NULL)) {
+        fprintf(stderr, "ERROR --shard AND --merge NEED -i AND DO NOT WORK WITH -r.\n");
+        return 1;
+    }
+    if (resume && checkpoint == 0) {
+        checkpoint = CHECKPOINT_INTERVAL;
+    }
+
+    // a resumed run keeps what the interrupted one wrote, --merge opens its output itself
+    // once the parts are verified
+    if (outname != NULL && !merge) {
+        outfile = resume ? fopen(outname, "r+") : NULL;
+        if (outfile == NULL) {
+            outfile = fopen(outname, "w");
+        }
+        if (outfile == NULL) {
+            fprintf(stderr, "ERROR OUTFILE CANNOT BE OPENED.\n");
+            return 1;
+        }
+    }
+
+    // if threads is negative use a single thread
+    if ((int) threads < 0) {
+        threads = 1;
+    }
+
+    // load the tuning profile of this host, if there is one
+    profile_load(profile_file);
+
     // If no infile is specified set it to stdin
     if (infile == NULL) {
         infile = stdin;
@@ -57,6 +179,25 @@ int main(int argc, char **argv) {
         outfile = stdout;
     }
 
+    // joining the decrypted shards is plain copying, no key is involved
+    if (merge) {
+        bool ok = shard_merge(inname, argv + optind, argc - optind, outname);
+        fclose(infile);
+        if (pvfile != NULL) {
+            fclose(pvfile);
+        }
+        return ok ? 0 : 1;
+    }
+
+    // decrypt one shard as if it were the whole input
+    if (shard_flag) {
+        fclose(infile);
+        infile = shard_open(inname, shard);
+        if (infile == NULL) {
+            return 1;
+        }
+    }
+
     // check if private key file can be opened
     if (pvfile == NULL) {
         fprintf(stderr, "ERROR PVFILE CANNOT BE OPENED.\n");
@@ -68,18 +209,76 @@ int main(int argc, char **argv) {
     mpz_inits(pq, d, NULL);
     ss_read_priv(pq, d, pvfile);
 
+    // use the tuned parameters for this key size, -t overrides the thread count
+    profile_select(mpz_sizeinbase(pq, 2), PROFILE_PRIVATE);
+    if (threads == 0) {
+        threads = profile_threads();
+    }
+    char *inbuf = indir == NULL ? profile_setvbuf(infile) : NULL;
+    char *outbuf = indir == NULL ? profile_setvbuf(outfile) : NULL;
+
+    // memoize repeated blocks if asked to
+    if (cache_entries > 0) {
+        ss_cache_decrypt(cache_entries, pq);
+    }
+
+    // record progress next to the output, and pick up where an interrupted run stopped
+    Journal *journal = NULL;
+    if (checkpoint > 0) {
+        journal = journal_create(outname, infile, pq, checkpoint);
+        if (resume && !journal_resume(journal, infile, outfile)) {
+            journal_delete(&journal);
+            mpz_clears(pq, d, NULL);
+            return 1;
+        }
+    }
+
     // if verbose output is enabled
     if (verbose_flag == true) {
         gmp_printf("pq (%d bits) = %Zd\n", mpz_sizeinbase(pq, 2), pq); // the private modulus pq
         gmp_printf("d (%d bits) = %Zd\n", mpz_sizeinbase(d, 2), d); // the private key d
+        // the tuned parameters in use
+        printf("backend = %s, window = %lu, batch = %lu, threads = %lu, chunk = %lu\n",
+            backend->name, profile_window(mpz_sizeinbase(d, 2)), profile.batch, threads,
+            profile.chunk);
+        if (resume) {
+            Checkpoint ckpt = journal_progress(journal);
+            printf("resumed after block %lu, input byte %lu, output byte %lu\n", ckpt.blocks,
+                ckpt.in_off, ckpt.out_off);
+        }
     }
 
-    // decrypt the file
-    ss_decrypt_file(infile, outfile, d, pq);
+    // decrypt the directory or the file
+    if (indir != NULL) {
+        if (!batch_decrypt_dir(indir, outdir, d, pq, threads)) {
+            mpz_clears(pq, d, NULL);
+            return 1;
+        }
+    } else {
+        ss_decrypt_file(infile, outfile, d, pq, journal);
+        if (journal != NULL) {
+            journal_finish(journal, outfile);
+        }
+    }
 
-    // clear all variables and close the private key file
+    // clear all variables and close all files, before their stdio buffers are freed
+    fclose(infile);
+    fclose(outfile);
     fclose(pvfile);
+    free(inbuf);
+    free(outbuf);
+    journal_delete(&journal);
     mpz_clears(pq, d, NULL);
+    arena_clear();
+
+    // report the cache and the allocations once everything is freed
+    if (verbose_flag == true && decrypt_cache != NULL) {
+        cache_print_stats(decrypt_cache, "decrypt", stderr);
+    }
+    cache_delete(&decrypt_cache);
+    if (verbose_flag == true) {
+        arena_print_stats(stderr);
+    }
 
     // terminate the program
     return 0;
@@ -1,5 +1,10 @@
+#include "arena.h"
+#include "backend.h"
+#include "batch.h"
 #include "numtheory.h"
+#include "profile.h"
 #include "randstate.h"
+#include "shard.h"
 #include "ss.h"
 
 #include <gmp.h>
@@ -8,8 +13,22 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <getopt.h>
 
-#define OPTIONS "i:o:n:vh"
+#define OPTIONS "i:o:n:r:O:t:p:c:B:vh"
+
+// seconds between checkpoints when --resume is given without --checkpoint
+#define CHECKPOINT_INTERVAL 30
+
+// long options without a short form
+enum { OPT_CHECKPOINT = 256, OPT_RESUME, OPT_SHARDS };
+
+static const struct option long_options[] = {
+    { "checkpoint", required_argument, NULL, OPT_CHECKPOINT },
+    { "resume", no_argument, NULL, OPT_RESUME },
+    { "shards", required_argument, NULL, OPT_SHARDS },
+    { NULL, 0, NULL, 0 },
+};
 
 void usage(char *exec) {
     fprintf(stderr,
@@ -25,28 +44,124 @@ void usage(char *exec) {
         "   -v              Display verbose program output.\n"
         "   -i infile       Input file of data to encrypt (default: stdin).\n"
         "   -o outfile      Output file for encrypted data (default: stdout).\n"
-        "   -n pbfile       Public key file (default: ss.pub).\n",
-        exec);
+        "   -n pbfile       Public key file (default: ss.pub).\n"
+        "   -r indir        Encrypt every file under indir (requires -O).\n"
+        "   -O outdir       Output directory for -r.\n"
+        "   -t threads      Worker threads for -r (default: from profile, else online CPUs).\n"
+        "   -p profile      Tuning profile written by ss-tune (default: ~/.ss_tune).\n"
+        "   -B backend      Arithmetic backend: ref, fast, gmp, gmp-sec or check\n"
+        "                   (default: $SS_BACKEND, else fast).\n"
+        "   -c entries      Cache up to this many repeated blocks (default: 0, off).\n"
+        "   --checkpoint secs\n"
+        "                   Record progress in outfile.ckpt every secs seconds (requires -o).\n"
+        "   --resume        Continue an interrupted run from outfile.ckpt, checkpointing\n"
+        "                   every %d seconds unless --checkpoint is given (requires -i and -o).\n"
+        "   --shards count  Split the output into count shards, outfile.0 and up, that decrypt\n"
+        "                   can process separately, with outfile as their manifest\n"
+        "                   (requires -i and -o, runs on -t threads).\n",
+        exec, CHECKPOINT_INTERVAL);
 }
 
 int main(int argc, char **argv) {
     int opt = 0;
     FILE *infile = NULL;
+    char *inname = NULL;
     FILE *outfile = NULL;
+    char *outname = NULL;
     FILE *pbfile = fopen("ss.pub", "r");
+    char *indir = NULL;
+    char *outdir = NULL;
+    uint64_t threads = 0;
+    char *profile_file = NULL;
+    char *backend_name = NULL;
+    uint64_t cache_entries = 0;
+    uint64_t checkpoint = 0;
+    bool resume = false;
+    uint64_t shards = 0;
     bool verbose_flag = false;
 
-    while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+    while ((opt = getopt_long(argc, argv, OPTIONS, long_options, NULL)) != -1) {
         switch (opt) {
-        case 'i': infile = fopen(optarg, "r"); break;
-        case 'o': outfile = fopen(optarg, "w"); break;
+        case 'i':
+            inname = optarg;
+            infile = fopen(optarg, "r");
+            break;
+        case 'o': outname = optarg; break;
         case 'n': pbfile = fopen(optarg, "r"); break;
+        case 'r': indir = optarg; break;
+        case 'O': outdir = optarg; break;
+        case 't': threads = strtoul(optarg, NULL, 10); break;
+        case 'p': profile_file = optarg; break;
+        case 'B': backend_name = optarg; break;
+        case 'c': cache_entries = strtoul(optarg, NULL, 10); break;
+        case OPT_CHECKPOINT: checkpoint = strtoul(optarg, NULL, 10); break;
+        case OPT_RESUME: resume = true; break;
+        case OPT_SHARDS: shards = strtoul(optarg, NULL, 10); break;
         case 'v': verbose_flag = true; break;
         case 'h': usage(argv[0]); return 0;
         default: usage(argv[0]); return 0;
         }
     }
 
+    // switch arithmetic engines, -B overrides $SS_BACKEND
+    if (!backend_select(backend_name)) {
+        fprintf(stderr, "ERROR UNKNOWN BACKEND, CHOOSE ONE OF: ");
+        backend_list(stderr);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    // count GMP allocations before any number is created
+    if (verbose_flag == true) {
+        arena_track();
+    }
+
+    // directory mode needs both directories
+    if ((indir == NULL) != (outdir == NULL)) {
+        fprintf(stderr, "ERROR -r AND -O MUST BE USED TOGETHER.\n");
+        return 1;
+    }
+
+    // checkpoints describe one input and one output file
+    if ((checkpoint > 0 || resume) && (outname == NULL || indir != NULL)) {
+        fprintf(stderr, "ERROR --checkpoint AND --resume NEED -o AND DO NOT WORK WITH -r.\n");
+        return 1;
+    }
+    if (resume && infile == NULL) {
+        fprintf(stderr, "ERROR --resume NEEDS -i.\n");
+        return 1;
+    }
+    // shards are written from one named input file to files named after the manifest
+    if (shards > 0
+        && (inname == NULL || outname == NULL || indir != NULL || checkpoint > 0 || resume)) {
+        fprintf(stderr,
+            "ERROR --shards NEEDS -i AND -o AND DOES NOT WORK WITH -r OR CHECKPOINTS.\n");
+        return 1;
+    }
+    if (resume && checkpoint == 0) {
+        checkpoint = CHECKPOINT_INTERVAL;
+    }
+
+    // a resumed run keeps what the interrupted one wrote, shards write their own files
+    if (outname != NULL && shards == 0) {
+        outfile = resume ? fopen(outname, "r+") : NULL;
+        if (outfile == NULL) {
+            outfile = fopen(outname, "w");
+        }
+        if (outfile == NULL) {
+            fprintf(stderr, "ERROR OUTFILE CANNOT BE OPENED.\n");
+            return 1;
+        }
+    }
+
+    // if threads is negative use a single thread
+    if ((int) threads < 0) {
+        threads = 1;
+    }
+
+    // load the tuning profile of this host, if there is one
+    profile_load(profile_file);
+
     // If no infile is specified set it to stdin
     if (infile == NULL) {
         infile = stdin;
@@ -71,20 +186,81 @@ int main(int argc, char **argv) {
 
     ss_read_pub(n, username_read, pbfile);
 
+    // use the tuned parameters for this key size, -t overrides the thread count
+    profile_select(mpz_sizeinbase(n, 2), PROFILE_PUBLIC);
+    if (threads == 0) {
+        threads = profile_threads();
+    }
+    char *inbuf = indir == NULL ? profile_setvbuf(infile) : NULL;
+    char *outbuf = indir == NULL ? profile_setvbuf(outfile) : NULL;
+
+    // memoize repeated blocks if asked to
+    if (cache_entries > 0) {
+        ss_cache_encrypt(cache_entries, n);
+    }
+
+    // record progress next to the output, and pick up where an interrupted run stopped
+    Journal *journal = NULL;
+    if (checkpoint > 0) {
+        journal = journal_create(outname, infile, n, checkpoint);
+        if (resume && !journal_resume(journal, infile, outfile)) {
+            journal_delete(&journal);
+            mpz_clear(n);
+            return 1;
+        }
+    }
+
     // if verbose output is enabled
     if (verbose_flag == true) {
         gmp_printf("user = %s\n", username_read); // username
         gmp_printf("n (%d bits) = %Zd\n", mpz_sizeinbase(n, 2), n); // the public key n
+        // the tuned parameters in use
+        printf("backend = %s, window = %lu, batch = %lu, threads = %lu, chunk = %lu\n",
+            backend->name, profile_window(mpz_sizeinbase(n, 2)), profile.batch, threads,
+            profile.chunk);
+        if (resume) {
+            Checkpoint ckpt = journal_progress(journal);
+            printf("resumed after block %lu, input byte %lu, output byte %lu\n", ckpt.blocks,
+                ckpt.in_off, ckpt.out_off);
+        }
     }
 
-    // encrypt the file
-    ss_encrypt_file(infile, outfile, n);
+    // encrypt the directory, the shards or the file
+    if (indir != NULL) {
+        if (!batch_encrypt_dir(indir, outdir, n, threads)) {
+            mpz_clear(n);
+            return 1;
+        }
+    } else if (shards > 0) {
+        if (!shard_encrypt_file(inname, outname, n, shards, threads)) {
+            mpz_clear(n);
+            return 1;
+        }
+    } else {
+        ss_encrypt_file(infile, outfile, n, journal);
+        if (journal != NULL) {
+            journal_finish(journal, outfile);
+        }
+    }
 
     // clear all variables and close all files
     fclose(infile);
     fclose(outfile);
     fclose(pbfile);
+    free(inbuf);
+    free(outbuf);
+    journal_delete(&journal);
     mpz_clear(n);
+    arena_clear();
+
+    // report the cache and the allocations once everything is freed
+    if (verbose_flag == true && encrypt_cache != NULL) {
+        cache_print_stats(encrypt_cache, "encrypt", stderr);
+    }
+    cache_delete(&encrypt_cache);
+    if (verbose_flag == true) {
+        arena_print_stats(stderr);
+    }
 
     // terminate the program
     return 0;
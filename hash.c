@@ -0,0 +1,17 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "hash.h"
+
+uint64_t hash_bytes(uint64_t h, const uint8_t *bytes, size_t len) {
+    for (size_t i = 0; i < len; i += 1) {
+        h = (h ^ bytes[i]) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+uint64_t hash_mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+// FNV-1a offset basis, the hash_bytes value of no bytes
+#define HASH_START 0xCBF29CE484222325ULL
+
+//
+// Continues an FNV-1a hash over a run of bytes, so a long stream can be hashed a buffer at a time.
+//
+// h: the hash so far, HASH_START for a new one
+// bytes: the next bytes of the stream
+// len: number of bytes
+//
+// Returns the hash including the new bytes.
+//
+uint64_t hash_bytes(uint64_t h, const uint8_t *bytes, size_t len);
+
+//
+// The SplitMix64 finalizer, a bijective mix of all 64 input bits.
+// Spreads a hash that is weak in some bits over all of them.
+//
+uint64_t hash_mix(uint64_t x);
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "hash.h"
+#include "journal.h"
+#include "path.h"
+
+struct Journal {
+    char *path; // <outname>.ckpt
+    char *tmp; // <outname>.ckpt.tmp, renamed over path
+    uint64_t key; // fingerprint of the key in use
+    uint64_t in_size; // size of the input the run was started on
+    uint64_t interval;
+    time_t last; // when the last checkpoint was written
+    bool failed; // set once a checkpoint could not be written
+    Checkpoint progress;
+};
+
+// seconds on a clock that never jumps back
+static time_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+// hashes the bytes of a key, finished with SplitMix64 so every bit of it counts
+static uint64_t fingerprint(const mpz_t key) {
+    // export into our own buffer, one GMP allocated would have to go back through GMP's free
+    size_t count = 0;
+    uint8_t *bytes = (uint8_t *) malloc(mpz_sizeinbase(key, 256));
+    mpz_export(bytes, &count, 1, 1, 1, 0, key);
+    uint64_t h = hash_bytes(count * 0x9E3779B97F4A7C15ULL, bytes, count);
+    free(bytes);
+    return hash_mix(h);
+}
+
+// returns the size of an open file, or -1 if it is not a regular file
+static off_t file_size(FILE *file) {
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return -1;
+    }
+    return st.st_size;
+}
+
+Journal *journal_create(const char *outname, FILE *infile, const mpz_t key, uint64_t interval) {
+    Journal *journal = (Journal *) calloc(1, sizeof(Journal));
+    journal->path = path_suffix(outname, ".ckpt");
+    journal->tmp = path_suffix(outname, ".ckpt.tmp");
+    journal->key = fingerprint(key);
+    // a pipe has no size to match on resume, which needs a regular file anyway
+    off_t in_size = file_size(infile);
+    journal->in_size = in_size < 0 ? UINT64_MAX : (uint64_t) in_size;
+    journal->interval = interval;
+    journal->last = now();
+    return journal;
+}
+
+void journal_delete(Journal **journal) {
+    if (*journal != NULL) {
+        free((*journal)->path);
+        free((*journal)->tmp);
+        free(*journal);
+        *journal = NULL;
+    }
+}
+
+bool journal_resume(Journal *journal, FILE *infile, FILE *outfile) {
+    // no journal means the run died before its first checkpoint
+    Checkpoint ckpt = { 0, 0, 0 };
+    FILE *file = fopen(journal->path, "r");
+    if (file != NULL) {
+        uint64_t key, in_size;
+        int read = fscanf(file, "ss-checkpoint %lx %lu %lu %lu %lu", &key, &in_size,
+            &ckpt.in_off, &ckpt.out_off, &ckpt.blocks);
+        fclose(file);
+        if (read != 5) {
+            fprintf(stderr, "ERROR CHECKPOINT %s CANNOT BE READ.\n", journal->path);
+            return false;
+        }
+        if (key != journal->key) {
+            fprintf(stderr, "ERROR CHECKPOINT %s WAS MADE WITH ANOTHER KEY.\n", journal->path);
+            return false;
+        }
+        if (in_size != journal->in_size) {
+            fprintf(stderr, "ERROR CHECKPOINT %s WAS MADE FOR ANOTHER INPUT.\n", journal->path);
+            return false;
+        }
+    }
+
+    // both files must still hold everything the checkpoint covers
+    off_t in_size = file_size(infile), out_size = file_size(outfile);
+    if (in_size < 0 || out_size < 0) {
+        fprintf(stderr, "ERROR --resume NEEDS REGULAR INPUT AND OUTPUT FILES.\n");
+        return false;
+    }
+    if ((uint64_t) in_size < ckpt.in_off || (uint64_t) out_size < ckpt.out_off) {
+        fprintf(stderr, "ERROR CHECKPOINT %s IS AHEAD OF THE FILES.\n", journal->path);
+        return false;
+    }
+
+    // drop whatever was written after the checkpoint and continue behind it
+    if (ftruncate(fileno(outfile), (off_t) ckpt.out_off) != 0
+        || fseeko(outfile, (off_t) ckpt.out_off, SEEK_SET) != 0
+        || fseeko(infile, (off_t) ckpt.in_off, SEEK_SET) != 0) {
+        fprintf(stderr, "ERROR CHECKPOINT %s CANNOT BE RESUMED.\n", journal->path);
+        return false;
+    }
+
+    journal->progress = ckpt;
+    return true;
+}
+
+Checkpoint journal_progress(const Journal *journal) {
+    return journal->progress;
+}
+
+// syncs the output, then atomically replaces the journal with the current progress
+static void journal_write(Journal *journal, FILE *outfile) {
+    journal->last = now();
+
+    // the output must be on disk before a checkpoint points past it
+    bool ok = fflush(outfile) == 0 && fsync(fileno(outfile)) == 0;
+
+    FILE *file = ok ? fopen(journal->tmp, "w") : NULL;
+    ok = file != NULL;
+    if (ok) {
+        fprintf(file, "ss-checkpoint %016lx %lu %lu %lu %lu\n", journal->key, journal->in_size,
+            journal->progress.in_off, journal->progress.out_off, journal->progress.blocks);
+        ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+        ok = fclose(file) == 0 && ok;
+    }
+    ok = ok && rename(journal->tmp, journal->path) == 0;
+
+    // keep going without checkpoints rather than fail the run
+    if (!ok && !journal->failed) {
+        fprintf(stderr, "ERROR CHECKPOINT %s CANNOT BE WRITTEN.\n", journal->path);
+        journal->failed = true;
+    }
+}
+
+void journal_step(Journal *journal, FILE *outfile, uint64_t in_bytes, uint64_t out_bytes) {
+    journal->progress.in_off += in_bytes;
+    journal->progress.out_off += out_bytes;
+    journal->progress.blocks += 1;
+    if ((uint64_t) (now() - journal->last) >= journal->interval) {
+        journal_write(journal, outfile);
+    }
+}
+
+void journal_finish(Journal *journal, FILE *outfile) {
+    if (fflush(outfile) == 0 && fsync(fileno(outfile)) == 0) {
+        unlink(journal->path);
+    }
+}
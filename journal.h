@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Progress of ss_encrypt_file or ss_decrypt_file as recorded by a checkpoint.
+//
+typedef struct {
+    uint64_t in_off; // input bytes consumed by the completed blocks
+    uint64_t out_off; // output bytes those blocks produced
+    uint64_t blocks; // number of completed blocks
+} Checkpoint;
+
+typedef struct Journal Journal;
+
+//
+// Creates a checkpoint journal for an output file, kept in "<outname>.ckpt".
+// Nothing is written until the first checkpoint is due.
+//
+// outname: path of the output file
+// infile: input of the run; its size is recorded so a journal left for another input is refused
+// key: modulus of the key in use, n when encrypting and pq when decrypting; a fingerprint of it
+//      is recorded so a journal left by another key is refused
+// interval: seconds between checkpoints
+//
+Journal *journal_create(const char *outname, FILE *infile, const mpz_t key, uint64_t interval);
+
+//
+// Frees a journal and sets the pointer to NULL. The journal file is left in place.
+//
+void journal_delete(Journal **journal);
+
+//
+// Continues an interrupted run from its last checkpoint: outfile is cut back to the
+// recorded output offset and both streams are moved to the recorded offsets.
+// Without a journal file the run starts over from the beginning.
+// Must be called before any other I/O on either stream.
+//
+// Requires:
+//  infile: open and seekable input of the interrupted run
+//  outfile: its output, opened for update without truncating it
+//
+// Returns false if the journal cannot be read, was made with another key or for an input
+// of another size, or points past the end of either file.
+//
+bool journal_resume(Journal *journal, FILE *infile, FILE *outfile);
+
+//
+// Returns the progress recorded so far, including what journal_resume restored.
+//
+Checkpoint journal_progress(const Journal *journal);
+
+//
+// Records one completed block, writing a checkpoint once the interval has passed.
+// The output is flushed and synced to disk before the checkpoint that covers it,
+// and the checkpoint replaces the previous one atomically.
+//
+// in_bytes: input bytes the block consumed
+// out_bytes: output bytes the block produced
+//
+void journal_step(Journal *journal, FILE *outfile, uint64_t in_bytes, uint64_t out_bytes);
+
+//
+// Marks the run complete: syncs the output to disk, then removes the journal file.
+//
+void journal_finish(Journal *journal, FILE *outfile);
@@ -1,4 +1,7 @@
+#include "arena.h"
+#include "backend.h"
 #include "numtheory.h"
+#include "profile.h"
 #include "randstate.h"
 #include "ss.h"
 
@@ -17,7 +20,8 @@ void usage(char *exec) {
         "   Generates an SS public/private key pair.\n"
         "\n"
         "USAGE\n"
-        "   %s [-hv] [-b bits] [-i iters] [-n pbfile.pub] [-d pvfile.priv] [-s seed]\n"
+        "   %s [-hv] [-b bits] [-i iters] [-n pbfile.pub] [-d pvfile.priv] [-s seed] [-p profile]\n"
+        "          [-B backend] [-t threads]\n"
         // https://discord.com/channels/1035678172856995900/1061813507164733460/1077481653443756072 above line from this
         "\n"
         "OPTIONS\n"
@@ -27,11 +31,16 @@ void usage(char *exec) {
         "   -i iterations   Miller-Rabin iterations for testing primes (default: 50).\n"
         "   -n pbfile       Public key file (default: ss.pub).\n"
         "   -d pvfile       Private key file (default: ss.priv).\n"
-        "   -s seed         Random seed for testing.\n",
+        "   -s seed         Random seed for testing.\n"
+        "   -t threads      Threads for the Miller-Rabin rounds of large primes\n"
+        "                   (default: from profile, else online CPUs).\n"
+        "   -p profile      Tuning profile written by ss-tune (default: ~/.ss_tune).\n"
+        "   -B backend      Arithmetic backend: ref, fast, gmp, gmp-sec or check\n"
+        "                   (default: $SS_BACKEND, else fast).\n",
         exec);
 }
 
-#define OPTIONS "b:i:n:d:s:vh"
+#define OPTIONS "b:i:n:d:s:p:B:t:vh"
 
 int main(int argc, char **argv) {
     int opt = 0;
@@ -41,6 +50,9 @@ int main(int argc, char **argv) {
     bool verbose_flag = false;
     char *pb_file = "ss.pub";
     char *pv_file = "ss.priv";
+    char *profile_file = NULL;
+    char *backend_name = NULL;
+    uint64_t threads = 0;
 
     while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
         switch (opt) {
@@ -49,12 +61,28 @@ int main(int argc, char **argv) {
         case 'n': pb_file = optarg; break;
         case 'd': pv_file = optarg; break;
         case 's': seed = strtol(optarg, NULL, 10); break;
+        case 'p': profile_file = optarg; break;
+        case 'B': backend_name = optarg; break;
+        case 't': threads = strtoul(optarg, NULL, 10); break;
         case 'v': verbose_flag = true; break;
         case 'h': usage(argv[0]); return 0;
         default: usage(argv[0]); return 0;
         }
     }
 
+    // switch arithmetic engines, -B overrides $SS_BACKEND
+    if (!backend_select(backend_name)) {
+        fprintf(stderr, "ERROR UNKNOWN BACKEND, CHOOSE ONE OF: ");
+        backend_list(stderr);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    // count GMP allocations before any number is created
+    if (verbose_flag == true) {
+        arena_track();
+    }
+
     // if iters is negative set it to the default 50
     if ((int) iters < 0) {
         iters = 50;
@@ -89,6 +117,14 @@ int main(int argc, char **argv) {
     int file_perm = fileno(pvfile);
     fchmod(file_perm, 0600);
 
+    // use the tuned parameters of this host for the key size, -t overrides the thread count;
+    // n is not made yet, so the entry is matched on the nominal size it was tuned for
+    profile_load(profile_file);
+    profile_select(bits, PROFILE_NOMINAL);
+    if ((int) threads > 0) {
+        profile.threads = threads;
+    }
+
     // Initialize the random state
     randstate_init(seed);
 
@@ -119,6 +155,13 @@ int main(int argc, char **argv) {
         gmp_printf("n (%d bits) = %Zd\n", mpz_sizeinbase(n, 2), n); // the public key n
         gmp_printf("d (%d bits) = %Zd\n", mpz_sizeinbase(d, 2), d); // the private exponent d
         gmp_printf("pq (%d bits) = %Zd\n", mpz_sizeinbase(pq, 2), pq); // the private modulus pq
+        // the work the prime search took
+        printf("backend = %s\n", backend->name);
+        printf("threads = %lu\n", profile_threads());
+        printf("sieve windows = %lu\n", pub_stats.windows);
+        printf("sieved candidates = %lu\n", pub_stats.sieved);
+        printf("primality tests = %lu\n", pub_stats.prime_tests);
+        printf("retries = %lu\n", pub_stats.retries);
     }
 
     // clear all variables and close all files
@@ -126,6 +169,12 @@ int main(int argc, char **argv) {
     fclose(pvfile);
     randstate_clear();
     mpz_clears(p, q, n, d, pq, NULL);
+    arena_clear();
+
+    // report the allocations once everything is freed
+    if (verbose_flag == true) {
+        arena_print_stats(stdout);
+    }
 
     // terminate the program
     return 0;
@@ -2,16 +2,25 @@
 #include <gmp.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
 
+#include "arena.h"
+#include "backend.h"
 #include "numtheory.h"
+#include "pool.h"
+#include "profile.h"
 #include "randstate.h"
 
+// smallest candidate size whose Miller-Rabin rounds are spread over threads
+#define PRIME_PARALLEL_BITS 2048
+
 // all functions are pseudo code translation from assignment pdf
 
 // computer the greatest common divisor of "a" and "b" and store the results in "g"
 void gcd(mpz_t g, const mpz_t a, const mpz_t b) {
-    mpz_t a_tmp, b_tmp, t;
-    mpz_inits(a_tmp, b_tmp, t, NULL);
+    Arena *arena = arena_get();
+    mpz_ptr a_tmp = arena->gcd_a, b_tmp = arena->gcd_b, t = arena->gcd_t;
 
     // store a in its tmp variable
     mpz_set(a_tmp, a);
@@ -26,16 +35,14 @@ void gcd(mpz_t g, const mpz_t a, const mpz_t b) {
 
     // mimic returning a by setting param g as the value of a
     mpz_set(g, a_tmp);
-
-    // clear all mpz variables
-    mpz_clears(a_tmp, b_tmp, t, NULL);
 }
 
 // computer the inverse "o"  of a modulo "n"
 void mod_inverse(mpz_t o, const mpz_t a, const mpz_t n) {
-    // initialize all variables
-    mpz_t r, r_prime, t, t_prime, q, r_tmp, qr_product, t_tmp, qt_product;
-    mpz_inits(r, r_prime, t, t_prime, q, r_tmp, qr_product, t_tmp, qt_product, NULL);
+    Arena *arena = arena_get();
+    mpz_ptr r = arena->inv_r, r_prime = arena->inv_r_prime, t = arena->inv_t,
+            t_prime = arena->inv_t_prime, q = arena->inv_q, r_tmp = arena->inv_r_tmp,
+            qr_product = arena->inv_qr, t_tmp = arena->inv_t_tmp, qt_product = arena->inv_qt;
 
     mpz_set(r, n); // set r equal to n
     mpz_set(r_prime, a); // set r_prime equal to a
@@ -83,126 +90,191 @@ void mod_inverse(mpz_t o, const mpz_t a, const mpz_t n) {
 
     // mimic returning "t" by setting t to "o"
     mpz_set(o, t);
-
-    // clear all mpz variables
-    mpz_clears(r, r_prime, t, t_prime, q, r_tmp, qr_product, t_tmp, qt_product, NULL);
 }
 
 // "o" stores the computed result, "a" represents the base raised to the exponent "d" power modulo "n"
-// computes fast modular exponentiation
+// computes fast modular exponentiation, consuming profile_window() bits of "d" per multiplication
 void pow_mod(mpz_t o, const mpz_t a, const mpz_t d, const mpz_t n) {
-    // initialize all variables
-    mpz_t p, o_tmp, d_tmp, two;
-    mpz_inits(p, o_tmp, d_tmp, two, NULL);
-
-    mpz_set(d_tmp, d); // store d as a tmp var
+    Arena *arena = arena_get();
+    mpz_ptr o_tmp = arena->pow_o;
+    mpz_t *table = arena->pow_table;
+
+    // the window grows with the exponent unless the profile fixes it
+    size_t bits = mpz_sizeinbase(d, 2);
+    uint64_t w = profile_window(bits);
+
+    // table[i] = a^i mod n for every window value i
+    mpz_set_ui(table[0], 1);
+    mpz_mod(table[1], a, n);
+    for (uint64_t i = 2; i < ((uint64_t) 1 << w); i += 1) {
+        mpz_mul(table[i], table[i - 1], table[1]);
+        mpz_mod(table[i], table[i], n);
+    }
 
-    mpz_set(p, a); // set p to a
     mpz_set_ui(o_tmp, 1); // setting v to 1
 
-    while (mpz_sgn(d_tmp) > 0) {
-        // check if d is odd using built in function
-        if (mpz_odd_p(d_tmp) != 0) {
-            // perform (v * p)
-            mpz_mul(o_tmp, o_tmp, p);
-            // perform mod n and assign to o_tmp
+    // walk "d" from the most significant window down
+    size_t pos = mpz_sgn(d) > 0 ? (bits + w - 1) / w * w : 0;
+    while (pos > 0) {
+        pos -= w;
+
+        // make room for the next window by squaring w times
+        uint64_t window = 0;
+        for (uint64_t i = w; i-- > 0;) {
+            mpz_mul(o_tmp, o_tmp, o_tmp);
             mpz_mod(o_tmp, o_tmp, n);
+            window = (window << 1) | mpz_tstbit(d, pos + i);
         }
 
-        // perform (p * p)
-        mpz_mul(p, p, p);
-        // perform mod n and assign to p
-        mpz_mod(p, p, n);
-
-        // floor divide d_tmp by 2 and assign to d_tmp
-        mpz_fdiv_q_ui(d_tmp, d_tmp, 2);
+        // multiply in the power of "a" the window selects
+        if (window != 0) {
+            mpz_mul(o_tmp, o_tmp, table[window]);
+            mpz_mod(o_tmp, o_tmp, n);
+        }
     }
 
     // mimic return v by setting value of o_tmp to the parameter o
     mpz_set(o, o_tmp);
+}
+
+// one Miller-Rabin round with the witness "a", where n - 1 = r * 2^s
+// returns false if "a" proves "n" composite
+static bool witness_round(const mpz_t n, const mpz_t r, uint64_t s, const mpz_t a) {
+    Arena *arena = arena_get();
+    mpz_ptr y = arena->prime_y, n_min_one = arena->prime_n_min_one, two = arena->prime_two;
+
+    // compute and store n - 1
+    mpz_sub_ui(n_min_one, n, 1);
+    mpz_set_ui(two, 2);
+
+    // compute the power mod of a,r,n and store in y
+    backend->pow_mod(y, a, r, n);
+
+    if (mpz_cmp_ui(y, 1) != 0 && mpz_cmp(y, n_min_one) != 0) {
+        // j <-- 1 up to s - 1
+        for (uint64_t j = 1; j < s && mpz_cmp(y, n_min_one) != 0; j += 1) {
+            backend->pow_mod(y, y, two, n);
+
+            if (mpz_cmp_ui(y, 1) == 0) {
+                return false;
+            }
+        }
+
+        if (mpz_cmp(y, n_min_one) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
 
-    // clear all mpz variables
-    mpz_clears(p, o_tmp, d_tmp, two, NULL);
+// the rounds of one is_prime call shared between pool workers
+typedef struct {
+    mpz_srcptr n, r;
+    uint64_t s;
+    mpz_t *witness;
+    atomic_bool composite; // set by the first round that fails, the rest are skipped
+} Rounds;
+
+typedef struct {
+    Rounds *rounds;
+    uint64_t i;
+} RoundTask;
+
+static void round_task(void *arg) {
+    RoundTask *task = (RoundTask *) arg;
+    Rounds *rounds = task->rounds;
+    if (!atomic_load(&rounds->composite)
+        && !witness_round(rounds->n, rounds->r, rounds->s, rounds->witness[task->i])) {
+        atomic_store(&rounds->composite, true);
+    }
 }
 
 // Miller-Rabin test for prime "n" using "iters" number of iterations
 bool is_prime(const mpz_t n, uint64_t iters) {
-    mpz_t r, s, n_temp, n_min_three, a, y, n_min_one, j, s_min_one, two;
-    mpz_inits(r, s, n_temp, n_min_three, a, y, n_min_one, j, s_min_one, two, NULL);
+    Arena *arena = arena_get();
+    mpz_ptr r = arena->prime_r, n_min_three = arena->prime_n_min_three, a = arena->prime_a;
 
     // number checks derived from Professor Longs example on discord
     // https://discord.com/channels/1035678172856995900/1061813507164733460/1063224264649605120
     if (mpz_cmp_ui(n, 3) == 0) {
-        // clears mpz vars
         return true;
     }
     if (mpz_cmp_ui(n, 2) == 0) {
-        // clears mpz vars
         return true;
     }
     if (mpz_cmp_ui(n, 1) == 0) {
-        // clears mpz vars
         return false;
     }
     if (mpz_cmp_ui(n, 0) == 0) {
-        // clears mpz vars
         return false;
     }
 
     // finding the values of r and s while r is odd
     // inspired from Miles Tutoring Section 2/21/2023
-    mpz_sub_ui(n_temp, n, 1);
-    mpz_set(r, n_temp);
-    while (mpz_even_p(r) != 0) {
-        mpz_div_ui(r, r, 2);
-        mpz_add_ui(s, s, 1);
-    }
-
-    //mpz_sub_ui(n_min_three, n, 3);
-    mpz_sub_ui(s_min_one, s, 1);
-
-    mpz_set_ui(two, 2);
-
-    for (uint64_t i = 1; i < iters; i += 1) {
-        mpz_sub_ui(n_min_three, n, 3);
-        // choosing the random a
-        mpz_urandomm(a, state, n_min_three);
-        mpz_add_ui(a, a, 2); // allows for the {2,3,...n-2}
-
-        // compute the power mod of a,r,n and store in y
-        pow_mod(y, a, r, n);
-        // compute and store n - 1
-        mpz_sub_ui(n_min_one, n, 1);
+    mpz_sub_ui(r, n, 1);
+    uint64_t s = mpz_scan1(r, 0);
+    mpz_tdiv_q_2exp(r, r, s);
 
-        if (mpz_cmp_ui(y, 1) != 0 && mpz_cmp(y, n_min_one) != 0) {
-            mpz_set_ui(j, 1); // j <-- 1
-
-            while (mpz_cmp(j, s_min_one) <= 0 && mpz_cmp(y, n_min_one) != 0) {
-                pow_mod(y, y, two, n);
+    mpz_sub_ui(n_min_three, n, 3);
+    if (iters < 2) {
+        return true;
+    }
 
-                if (mpz_cmp_ui(y, 1) == 0) {
-                    mpz_clears(r, s, n_temp, n_min_three, a, y, n_min_one, j, s_min_one, two, NULL);
-                    return false;
-                }
+    // almost every composite fails the first round, so it always runs alone
+    // choosing the random a, rand_urandomm allows for the {2,3,...n-2}
+    rand_urandomm(a, n_min_three);
+    mpz_add_ui(a, a, 2);
+    if (!witness_round(n, r, s, a)) {
+        return false;
+    }
 
-                mpz_add_ui(j, j, 1); // j <-- j+1
-            }
+    // draw every other witness up front from this thread's stream, so the same seed
+    // gives the same witnesses however many threads test them
+    uint64_t count = iters - 2;
+    mpz_t *witness = (mpz_t *) malloc(count * sizeof(mpz_t));
+    for (uint64_t i = 0; i < count; i += 1) {
+        mpz_init(witness[i]);
+        rand_urandomm(witness[i], n_min_three);
+        mpz_add_ui(witness[i], witness[i], 2);
+    }
 
-            if (mpz_cmp(y, n_min_one) != 0) {
-                mpz_clears(r, s, n_temp, n_min_three, a, y, n_min_one, j, s_min_one, two, NULL);
-                return false;
-            }
+    // large candidates that passed are most likely prime and need every round,
+    // so spread the rounds over the worker threads
+    Rounds rounds = { n, r, s, witness, false };
+    uint64_t threads = profile_threads();
+    if (threads > count) {
+        threads = count;
+    }
+    if (threads > 1 && mpz_sizeinbase(n, 2) >= PRIME_PARALLEL_BITS) {
+        RoundTask *tasks = (RoundTask *) malloc(count * sizeof(RoundTask));
+        Pool *pool = pool_create(threads);
+        for (uint64_t i = 0; i < count; i += 1) {
+            tasks[i] = (RoundTask) { &rounds, i };
+            pool_submit(pool, round_task, &tasks[i]);
+        }
+        pool_wait(pool);
+        pool_delete(&pool);
+        free(tasks);
+    } else {
+        for (uint64_t i = 0; i < count && !atomic_load(&rounds.composite); i += 1) {
+            RoundTask task = { &rounds, i };
+            round_task(&task);
         }
     }
 
-    mpz_clears(r, s, n_temp, n_min_three, a, y, n_min_one, j, s_min_one, two, NULL);
-    return true;
+    for (uint64_t i = 0; i < count; i += 1) {
+        mpz_clear(witness[i]);
+    }
+    free(witness);
+
+    return !atomic_load(&rounds.composite);
 }
 
 // Generate a prime number which is to be stored in "p"
 void make_prime(mpz_t p, uint64_t bits, uint64_t iters) {
-    mpz_t bits_two, rand;
-    mpz_inits(bits_two, rand, NULL);
+    Arena *arena = arena_get();
+    mpz_ptr bits_two = arena->make_bits_two, rand = arena->make_rand;
     bool flag = true; // use as while loop condition when testing whether number is prime or not
 
     // set the bits to base 2
@@ -210,7 +282,7 @@ void make_prime(mpz_t p, uint64_t bits, uint64_t iters) {
 
     while (flag) {
         // create the random number from 0 to the bits
-        mpz_urandomb(rand, state, bits);
+        rand_urandomb(rand, bits);
         // add the bits in base 2 to the random number
         mpz_add(rand, rand, bits_two);
 
@@ -218,8 +290,6 @@ void make_prime(mpz_t p, uint64_t bits, uint64_t iters) {
         if (is_prime(rand, iters) == true) {
             // set the rand to p because it is a generated prime
             mpz_set(p, rand);
-            // clear all mpz variables
-            mpz_clears(bits_two, rand, NULL);
             flag = false;
         }
     }
@@ -0,0 +1,19 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "path.h"
+
+char *path_join(const char *dir, const char *name) {
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char *path = (char *) malloc(len);
+    snprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+char *path_suffix(const char *path, const char *suffix) {
+    size_t len = strlen(path) + strlen(suffix) + 1;
+    char *str = (char *) malloc(len);
+    snprintf(str, len, "%s%s", path, suffix);
+    return str;
+}
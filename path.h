@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdio.h>
+
+//
+// Returns a newly allocated "dir/name".
+//
+char *path_join(const char *dir, const char *name);
+
+//
+// Returns a newly allocated "path" followed by "suffix", as in "out.ckpt" from "out".
+//
+char *path_suffix(const char *path, const char *suffix);
@@ -0,0 +1,225 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "arena.h"
+#include "pool.h"
+#include "randstate.h"
+
+// pools created so far, numbering the random streams of their workers
+static atomic_uint_fast64_t pools_created;
+
+// a single queued task
+typedef struct {
+    PoolTask fn;
+    void *arg;
+} Task;
+
+// growable ring buffer of tasks owned by one worker
+typedef struct {
+    pthread_mutex_t lock;
+    Task *tasks;
+    uint64_t head; // index of the oldest task, stolen by other workers
+    uint64_t size; // number of queued tasks
+    uint64_t capacity;
+} Deque;
+
+struct Pool {
+    uint64_t serial; // order in which the pool was created
+    uint64_t threads;
+    pthread_t *tids;
+    Deque *deques;
+    pthread_mutex_t lock; // guards everything below
+    pthread_cond_t work; // signalled when a task is queued or the pool stops
+    pthread_cond_t idle; // signalled when the last active task finishes
+    uint64_t queued; // tasks sitting in a deque and not yet claimed by a worker
+    uint64_t active; // tasks submitted and not yet finished
+    uint64_t next; // deque the next outside submission goes to
+    bool stop;
+};
+
+// argument of a worker thread
+typedef struct {
+    Pool *pool;
+    uint64_t id;
+} Worker;
+
+// the pool and deque of the calling thread, if it is a worker
+static __thread Pool *self_pool = NULL;
+static __thread uint64_t self_id = 0;
+
+// adds a task to the newest end of a deque
+static void deque_push(Deque *dq, Task task) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->size == dq->capacity) {
+        // double the ring and unwrap it so the oldest task is at index 0
+        uint64_t capacity = dq->capacity * 2;
+        Task *tasks = (Task *) malloc(capacity * sizeof(Task));
+        for (uint64_t i = 0; i < dq->size; i += 1) {
+            tasks[i] = dq->tasks[(dq->head + i) % dq->capacity];
+        }
+        free(dq->tasks);
+        dq->tasks = tasks;
+        dq->head = 0;
+        dq->capacity = capacity;
+    }
+    dq->tasks[(dq->head + dq->size) % dq->capacity] = task;
+    dq->size += 1;
+    pthread_mutex_unlock(&dq->lock);
+}
+
+// takes the newest task (owner) or the oldest task (thief) from a deque
+static bool deque_take(Deque *dq, Task *task, bool steal) {
+    bool taken = false;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->size > 0) {
+        if (steal) {
+            *task = dq->tasks[dq->head];
+            dq->head = (dq->head + 1) % dq->capacity;
+        } else {
+            *task = dq->tasks[(dq->head + dq->size - 1) % dq->capacity];
+        }
+        dq->size -= 1;
+        taken = true;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return taken;
+}
+
+// runs tasks from its own deque, stealing from the others once it runs dry
+static void *pool_worker(void *arg) {
+    Worker *worker = (Worker *) arg;
+    Pool *pool = worker->pool;
+    self_pool = pool;
+    self_id = worker->id;
+
+    // draw from a stream fixed by the pool and worker index rather than by which thread
+    // happens to draw first; stream 0 stays with the main thread
+    randstate_stream(((pool->serial + 1) << 32) | worker->id);
+
+    while (true) {
+        // claim one queued task, or sleep until there is one
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->stop) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->queued == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pool->queued -= 1;
+        pthread_mutex_unlock(&pool->lock);
+
+        // the claim guarantees a task is in some deque, look in our own first
+        Task task;
+        bool taken = deque_take(&pool->deques[self_id], &task, false);
+        for (uint64_t i = 1; !taken; i += 1) {
+            taken = deque_take(&pool->deques[(self_id + i) % pool->threads], &task, true);
+        }
+
+        task.fn(task.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->active -= 1;
+        if (pool->active == 0) {
+            pthread_cond_broadcast(&pool->idle);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    // free the temporaries the tasks left in this thread's arena
+    arena_clear();
+    free(worker);
+    return NULL;
+}
+
+Pool *pool_create(uint64_t threads) {
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    Pool *pool = (Pool *) calloc(1, sizeof(Pool));
+    pool->serial = atomic_fetch_add(&pools_created, 1);
+    pool->threads = threads;
+    pool->tids = (pthread_t *) calloc(threads, sizeof(pthread_t));
+    pool->deques = (Deque *) calloc(threads, sizeof(Deque));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (uint64_t i = 0; i < threads; i += 1) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->deques[i].capacity = 16;
+        pool->deques[i].tasks = (Task *) calloc(16, sizeof(Task));
+    }
+
+    for (uint64_t i = 0; i < threads; i += 1) {
+        Worker *worker = (Worker *) malloc(sizeof(Worker));
+        worker->pool = pool;
+        worker->id = i;
+        pthread_create(&pool->tids[i], NULL, pool_worker, worker);
+    }
+
+    return pool;
+}
+
+void pool_submit(Pool *pool, PoolTask fn, void *arg) {
+    uint64_t id;
+    if (self_pool == pool) {
+        id = self_id;
+    } else {
+        pthread_mutex_lock(&pool->lock);
+        id = pool->next;
+        pool->next = (pool->next + 1) % pool->threads;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    // count the task as active before it can possibly run and finish
+    pthread_mutex_lock(&pool->lock);
+    pool->active += 1;
+    pthread_mutex_unlock(&pool->lock);
+
+    deque_push(&pool->deques[id], (Task) { fn, arg });
+
+    pthread_mutex_lock(&pool->lock);
+    pool->queued += 1;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_wait(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_delete(Pool **pool) {
+    if (*pool == NULL) {
+        return;
+    }
+
+    pool_wait(*pool);
+
+    pthread_mutex_lock(&(*pool)->lock);
+    (*pool)->stop = true;
+    pthread_cond_broadcast(&(*pool)->work);
+    pthread_mutex_unlock(&(*pool)->lock);
+
+    for (uint64_t i = 0; i < (*pool)->threads; i += 1) {
+        pthread_join((*pool)->tids[i], NULL);
+        pthread_mutex_destroy(&(*pool)->deques[i].lock);
+        free((*pool)->deques[i].tasks);
+    }
+
+    pthread_mutex_destroy(&(*pool)->lock);
+    pthread_cond_destroy(&(*pool)->work);
+    pthread_cond_destroy(&(*pool)->idle);
+    free((*pool)->tids);
+    free((*pool)->deques);
+    free(*pool);
+    *pool = NULL;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Pool Pool;
+
+typedef void (*PoolTask)(void *arg);
+
+//
+// Creates a work-stealing thread pool.
+// Every worker owns a deque of tasks. A worker runs its own newest task first and,
+// when its deque is empty, steals the oldest task of another worker.
+// Worker i draws random numbers from its own stream, chosen by i and by the order in which
+// pools are created, so what a worker draws depends on the seed and not on thread start order.
+//
+// threads: number of worker threads to start
+//
+Pool *pool_create(uint64_t threads);
+
+//
+// Queues a task on the pool.
+// Tasks submitted from inside a worker go on that worker's own deque,
+// all other tasks are dealt out round robin.
+//
+// fn: function to run
+// arg: argument passed to fn
+//
+void pool_submit(Pool *pool, PoolTask fn, void *arg);
+
+//
+// Blocks until every submitted task, including tasks submitted by tasks, has finished.
+//
+void pool_wait(Pool *pool);
+
+//
+// Waits for all tasks, stops the workers and frees the pool.
+//
+void pool_delete(Pool **pool);
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "profile.h"
+
+// most key sizes a profile can hold
+#define PROFILE_ENTRIES 16
+
+// defaults used without a profile
+Profile profile = { 0, 0, 0, 0, 64, 0, 0 };
+
+// entries read by profile_load
+static Profile entries[PROFILE_ENTRIES];
+static size_t entry_count = 0;
+
+char *profile_path(void) {
+    char *home = getenv("HOME");
+    if (home == NULL) {
+        return NULL;
+    }
+    size_t len = strlen(home) + strlen("/.ss_tune") + 1;
+    char *path = (char *) malloc(len);
+    snprintf(path, len, "%s/.ss_tune", home);
+    return path;
+}
+
+void profile_load(const char *path) {
+    char *own = path == NULL ? profile_path() : NULL;
+    FILE *file = fopen(path == NULL ? own : path, "r");
+    free(own);
+    if (file == NULL) {
+        return;
+    }
+
+    // one "bits n_bits pq_bits window batch threads chunk" line per key size, '#' starts a comment
+    char line[256];
+    entry_count = 0;
+    while (entry_count < PROFILE_ENTRIES && fgets(line, sizeof(line), file) != NULL) {
+        Profile p;
+        if (line[0] == '#'
+            || sscanf(line, "%lu %lu %lu %lu %lu %lu %lu", &p.bits, &p.n_bits, &p.pq_bits, &p.window,
+                   &p.batch, &p.threads, &p.chunk)
+                   != 7) {
+            continue;
+        }
+        // ignore values the code cannot use
+        if (p.window > PROFILE_MAX_WINDOW || p.batch < 1) {
+            continue;
+        }
+        entries[entry_count] = p;
+        entry_count += 1;
+    }
+    fclose(file);
+}
+
+// the size an entry is matched on
+static uint64_t entry_bits(const Profile *entry, ProfileMatch match) {
+    switch (match) {
+    case PROFILE_NOMINAL: return entry->bits;
+    case PROFILE_PUBLIC: return entry->n_bits;
+    default: return entry->pq_bits;
+    }
+}
+
+void profile_select(uint64_t bits, ProfileMatch match) {
+    if (entry_count == 0) {
+        return;
+    }
+
+    // the largest width that fits, or else the smallest one
+    size_t best = 0;
+    for (size_t i = 1; i < entry_count; i += 1) {
+        uint64_t width = entry_bits(&entries[i], match);
+        uint64_t best_width = entry_bits(&entries[best], match);
+        bool fits = width <= bits;
+        bool best_fits = best_width <= bits;
+        if ((fits && (!best_fits || width > best_width)) || (!fits && !best_fits && width < best_width)) {
+            best = i;
+        }
+    }
+    profile = entries[best];
+}
+
+uint64_t profile_threads(void) {
+    if (profile.threads > 0) {
+        return profile.threads;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus < 1 ? 1 : (uint64_t) cpus;
+}
+
+uint64_t profile_window(uint64_t bits) {
+    // short exponents are not worth a table
+    if (bits <= 8) {
+        return 1;
+    }
+    if (profile.window > 0) {
+        return profile.window;
+    }
+
+    // a window of w costs about bits / w multiplications plus 2^w to fill the table
+    uint64_t best = 1;
+    for (uint64_t w = 2; w <= PROFILE_MAX_WINDOW; w += 1) {
+        if (bits / w + ((uint64_t) 1 << w) < bits / best + ((uint64_t) 1 << best)) {
+            best = w;
+        }
+    }
+    return best;
+}
+
+char *profile_setvbuf(FILE *file) {
+    if (profile.chunk == 0) {
+        return NULL;
+    }
+    char *buf = (char *) malloc(profile.chunk);
+    setvbuf(file, buf, _IOFBF, profile.chunk);
+    return buf;
+}
+
+bool profile_save(const char *path, const Profile *list, size_t count) {
+    char *own = path == NULL ? profile_path() : NULL;
+    FILE *file = fopen(path == NULL ? own : path, "w");
+    free(own);
+    if (file == NULL) {
+        return false;
+    }
+
+    fprintf(file, "# ss-tune profile: bits n_bits pq_bits window batch threads chunk\n");
+    for (size_t i = 0; i < count; i += 1) {
+        fprintf(file, "%lu %lu %lu %lu %lu %lu %lu\n", list[i].bits, list[i].n_bits,
+            list[i].pq_bits, list[i].window, list[i].batch, list[i].threads, list[i].chunk);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// largest exponent window pow_mod supports
+#define PROFILE_MAX_WINDOW 6
+
+//
+// Tunable parameters for one key size.
+//
+typedef struct {
+    uint64_t bits; // nominal key size the key was made with, keygen -b
+    uint64_t n_bits; // bits in the public modulus n of the key the parameters were measured with
+    uint64_t pq_bits; // bits in its private modulus pq
+    uint64_t window; // exponent bits per window in pow_mod, 0 to size it
+                     // by the exponent
+    uint64_t batch; // blocks per task in reencrypt and directory mode
+    uint64_t threads; // worker threads, 0 for one per online CPU
+    uint64_t chunk; // stdio buffer size for file I/O in bytes, 0 for the stdio default
+} Profile;
+
+//
+// The parameters currently in effect.
+// Starts out with built in defaults and is replaced by profile_select.
+//
+extern Profile profile;
+
+//
+// Returns the default profile path, $HOME/.ss_tune, or NULL if $HOME is not set.
+// The string is owned by the caller.
+//
+char *profile_path(void);
+
+//
+// Reads a tuning profile written by ss-tune.
+// A missing or unreadable file is not an error, the defaults are used instead.
+//
+// path: profile to read, NULL for profile_path()
+//
+void profile_load(const char *path);
+
+//
+// What profile_select matches on: the nominal size of a key still to be made, or the width
+// of the public or private modulus of an existing key.
+//
+typedef enum { PROFILE_NOMINAL, PROFILE_PUBLIC, PROFILE_PRIVATE } ProfileMatch;
+
+//
+// Makes the loaded entry for a key size the current profile.
+// Entries are matched on the nominal size, n_bits or pq_bits as chosen by "match". The entry
+// with the largest value not above "bits" is used, or the smallest entry if all are larger.
+// Nothing changes if no profile was loaded.
+//
+// bits: nominal key size for keygen, else the number of bits in n or pq of the key in use
+// match: which column of the entries "bits" is compared with
+//
+void profile_select(uint64_t bits, ProfileMatch match);
+
+//
+// Returns the thread count of the current profile, resolving 0 to the number of online CPUs.
+//
+uint64_t profile_threads(void);
+
+//
+// Returns the window to use for an exponent of "bits" bits.
+// The profile's window is used when it is set, otherwise the window that needs the fewest
+// multiplications for the exponent, so very large keys get wide windows without a profile.
+// Exponents of 8 bits or less, such as the squarings in is_prime, always use a window of 1.
+//
+uint64_t profile_window(uint64_t bits);
+
+//
+// Gives a stream a stdio buffer of profile.chunk bytes.
+// Must be called before any I/O on the stream.
+//
+// Returns the buffer, which must be freed after the stream is closed, or NULL if the
+// stdio default is kept.
+//
+char *profile_setvbuf(FILE *file);
+
+//
+// Writes a tuning profile.
+//
+// path: file to write, NULL for profile_path()
+// entries: one entry per key size
+// count: number of entries
+//
+// Returns false if the file could not be written.
+//
+bool profile_save(const char *path, const Profile *entries, size_t count);
@@ -1,20 +1,75 @@
 #include <stdio.h>
 #include <gmp.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "hash.h"
 #include "randstate.h"
 
-gmp_randstate_t state;
+// odd constant of the golden ratio used to step the counters
+#define GOLDEN 0x9E3779B97F4A7C15ULL
 
-// Initialize the global random state "state" with the Mersenne Twister algorithm
+// the seed every stream is derived from
+static uint64_t seed_base;
+
+// the calling thread's stream: a key derived from the seed and id, and a counter
+static __thread struct {
+    bool ready;
+    uint64_t key;
+    uint64_t counter;
+} stream;
+
+// Seed random() and restart the per-thread streams from "seed"
 void randstate_init(uint64_t seed) {
     srandom(seed);
-    gmp_randinit_mt(state);
-    gmp_randseed_ui(state, seed);
+    seed_base = seed;
+    stream.ready = false;
 }
 
-// Free and clear up memory allocated by initializing the global random state
+// Forget the calling thread's stream, nothing is allocated for the streams
 void randstate_clear(void) {
-    gmp_randclear(state);
+    stream.ready = false;
+}
+
+// Point the calling thread at stream "id" and start it from the beginning
+void randstate_stream(uint64_t id) {
+    stream.key = hash_mix(seed_base ^ hash_mix(id + GOLDEN));
+    stream.counter = 0;
+    stream.ready = true;
+}
+
+// Number "counter" of the calling thread's stream
+uint64_t rand_u64(void) {
+    if (!stream.ready) {
+        randstate_stream(0);
+    }
+    stream.counter += 1;
+    return hash_mix(stream.key + stream.counter * GOLDEN);
+}
+
+// Fill the limbs of "r" straight from the stream and cut off the bits above "bits"
+void rand_urandomb(mpz_t r, uint64_t bits) {
+    mp_size_t limbs = (bits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    if (limbs == 0) {
+        mpz_set_ui(r, 0);
+        return;
+    }
+
+    mp_limb_t *dst = mpz_limbs_write(r, limbs);
+    for (mp_size_t i = 0; i < limbs; i += 1) {
+        dst[i] = (mp_limb_t) rand_u64() & GMP_NUMB_MASK;
+    }
+    if (bits % GMP_NUMB_BITS != 0) {
+        dst[limbs - 1] &= ((mp_limb_t) 1 << (bits % GMP_NUMB_BITS)) - 1;
+    }
+    mpz_limbs_finish(r, limbs);
+}
+
+// Draw numbers with as many bits as "n" until one is below "n", which takes under two tries on average
+void rand_urandomm(mpz_t r, const mpz_t n) {
+    uint64_t bits = mpz_sizeinbase(n, 2);
+    do {
+        rand_urandomb(r, bits);
+    } while (mpz_cmp(r, n) >= 0);
 }
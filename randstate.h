@@ -4,8 +4,6 @@
 #include <gmp.h>
 #include <stdint.h>
 
-extern gmp_randstate_t state;
-
 //
 // Initializes the random state needed for SS key generation operations.
 // Must be called before any key generation or number theory operations are used.
@@ -19,3 +17,37 @@ void randstate_init(uint64_t seed);
 // Must be called after all key generation or number theory operations are used.
 //
 void randstate_clear(void);
+
+//
+// Selects the random stream the calling thread draws from.
+// Streams are counter based: number i of stream "id" is a hash of the seed, the id and i,
+// so every stream is independent and gives the same numbers for the same seed no matter
+// how threads are scheduled. A thread that never calls this draws from stream 0, the stream
+// of the main thread; pool workers select theirs by worker index when they start.
+//
+// id: the stream to use
+//
+void randstate_stream(uint64_t id);
+
+//
+// Returns the next 64 random bits of the calling thread's stream.
+//
+uint64_t rand_u64(void);
+
+//
+// Draws a uniform random number in [0, 2^bits) from the calling thread's stream.
+// A drop in replacement for mpz_urandomb that fills whole limbs at a time.
+//
+// r: initialized mpz_t for the result
+// bits: number of random bits
+//
+void rand_urandomb(mpz_t r, uint64_t bits);
+
+//
+// Draws a uniform random number in [0, n) from the calling thread's stream.
+// A drop in replacement for mpz_urandomm.
+//
+// r: initialized mpz_t for the result
+// n: exclusive upper bound, must be positive
+//
+void rand_urandomm(mpz_t r, const mpz_t n);
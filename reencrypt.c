@@ -0,0 +1,153 @@
+#include "arena.h"
+#include "backend.h"
+#include "numtheory.h"
+#include "profile.h"
+#include "randstate.h"
+#include "ss.h"
+
+#include <gmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#define OPTIONS "i:o:d:n:t:p:B:vh"
+
+void usage(char *exec) {
+    fprintf(stderr,
+        "SYNOPSIS\n"
+        "   Re-encrypts SS encrypted data from an old key pair to a new one.\n"
+        "   The plaintext is only ever held in memory.\n"
+        "\n"
+        "USAGE\n"
+        "   %s [OPTIONS]\n"
+        "\n"
+        "OPTIONS\n"
+        "   -h              Display program help and usage.\n"
+        "   -v              Display verbose program output.\n"
+        "   -i infile       Input file of data encrypted under the old key (default: stdin).\n"
+        "   -o outfile      Output file for data encrypted under the new key (default: stdout).\n"
+        "   -d pvfile       Old private key file (default: ss.priv).\n"
+        "   -n pbfile       New public key file (default: ss.pub).\n"
+        "   -t threads      Number of worker threads (default: from profile, else online CPUs).\n"
+        "   -p profile      Tuning profile written by ss-tune (default: ~/.ss_tune).\n"
+        "   -B backend      Arithmetic backend: ref, fast, gmp, gmp-sec or check\n"
+        "                   (default: $SS_BACKEND, else fast).\n",
+        exec);
+}
+
+int main(int argc, char **argv) {
+    int opt = 0;
+    FILE *infile = NULL;
+    FILE *outfile = NULL;
+    FILE *pvfile = fopen("ss.priv", "r");
+    FILE *pbfile = fopen("ss.pub", "r");
+    uint64_t threads = 0;
+    char *profile_file = NULL;
+    char *backend_name = NULL;
+    bool verbose_flag = false;
+
+    while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+        switch (opt) {
+        case 'i': infile = fopen(optarg, "r"); break;
+        case 'o': outfile = fopen(optarg, "w"); break;
+        case 'd': pvfile = fopen(optarg, "r"); break;
+        case 'n': pbfile = fopen(optarg, "r"); break;
+        case 't': threads = strtoul(optarg, NULL, 10); break;
+        case 'p': profile_file = optarg; break;
+        case 'B': backend_name = optarg; break;
+        case 'v': verbose_flag = true; break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return 0;
+        }
+    }
+
+    // If no infile is specified set it to stdin
+    if (infile == NULL) {
+        infile = stdin;
+    }
+
+    // If no outfile is specified set it to stdout
+    if (outfile == NULL) {
+        outfile = stdout;
+    }
+
+    // switch arithmetic engines, -B overrides $SS_BACKEND
+    if (!backend_select(backend_name)) {
+        fprintf(stderr, "ERROR UNKNOWN BACKEND, CHOOSE ONE OF: ");
+        backend_list(stderr);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    // count GMP allocations before any number is created
+    if (verbose_flag == true) {
+        arena_track();
+    }
+
+    // check if both key files can be opened
+    if (pvfile == NULL) {
+        fprintf(stderr, "ERROR PVFILE CANNOT BE OPENED.\n");
+        return 1;
+    }
+
+    if (pbfile == NULL) {
+        fprintf(stderr, "ERROR PBFILE CANNOT BE OPENED.\n");
+        return 1;
+    }
+
+    // if threads is negative use a single thread
+    if ((int) threads < 0) {
+        threads = 1;
+    }
+
+    // read the old private key and the new public key
+    mpz_t pq, d, n;
+    mpz_inits(pq, d, n, NULL);
+    char username_read[256] = "";
+    ss_read_priv(pq, d, pvfile);
+    ss_read_pub(n, username_read, pbfile);
+
+    // use the tuned parameters for the new key, whose blocks are the bulk of the work,
+    // -t overrides the thread count
+    profile_load(profile_file);
+    profile_select(mpz_sizeinbase(n, 2), PROFILE_PUBLIC);
+    if (threads == 0) {
+        threads = profile_threads();
+    }
+    char *inbuf = profile_setvbuf(infile);
+    char *outbuf = profile_setvbuf(outfile);
+
+    // if verbose output is enabled
+    if (verbose_flag == true) {
+        gmp_fprintf(stderr, "pq (%d bits) = %Zd\n", mpz_sizeinbase(pq, 2), pq); // the old private modulus
+        gmp_fprintf(stderr, "d (%d bits) = %Zd\n", mpz_sizeinbase(d, 2), d); // the old private key
+        gmp_fprintf(stderr, "user = %s\n", username_read); // username of the new key
+        gmp_fprintf(stderr, "n (%d bits) = %Zd\n", mpz_sizeinbase(n, 2), n); // the new public key
+        fprintf(stderr, "backend = %s, window = %lu, batch = %lu, threads = %lu, chunk = %lu\n",
+            backend->name, profile_window(mpz_sizeinbase(d, 2)), profile.batch, threads,
+            profile.chunk);
+    }
+
+    // re-encrypt the file in a single pass
+    ss_reencrypt_file(infile, outfile, d, pq, n, threads);
+
+    // clear all variables and close all files
+    fclose(infile);
+    fclose(outfile);
+    fclose(pvfile);
+    fclose(pbfile);
+    free(inbuf);
+    free(outbuf);
+    mpz_clears(pq, d, n, NULL);
+    arena_clear();
+
+    // report the allocations once everything is freed
+    if (verbose_flag == true) {
+        arena_print_stats(stderr);
+    }
+
+    // terminate the program
+    return 0;
+}
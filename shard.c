@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "hash.h"
+#include "path.h"
+#include "pool.h"
+#include "profile.h"
+#include "shard.h"
+#include "ss.h"
+
+// longest shard file name a manifest can hold
+#define SHARD_NAME_MAX 4096
+
+// bytes read at a time when hashing and merging
+#define MERGE_CHUNK 65536
+
+// plaintext range of one shard as recorded in the manifest
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t digest; // digest of the plaintext bytes of the range
+    char *name; // shard file, relative to the manifest's directory
+} Shard;
+
+// one shard being encrypted
+typedef struct {
+    const char *inname;
+    char *outpath;
+    mpz_srcptr n;
+    uint64_t start;
+    uint64_t end;
+    uint64_t digest; // set by shard_task
+    atomic_bool *failed;
+} ShardTask;
+
+// FNV-1a over the next "len" bytes of a file, continuing from digest "h"
+// Returns false if the file ends early or cannot be read.
+static bool digest_file(FILE *file, uint64_t len, uint64_t *h, char *buf) {
+    size_t j;
+    while (len > 0 && (j = fread(buf, 1, len < MERGE_CHUNK ? len : MERGE_CHUNK, file)) > 0) {
+        *h = hash_bytes(*h, (const uint8_t *) buf, j);
+        len -= j;
+    }
+    return len == 0 && !ferror(file);
+}
+
+// the name of file "index" of a manifest, with and without the manifest's directory
+static char *shard_name(const char *manifest, uint64_t index, bool with_dir) {
+    const char *base = strrchr(manifest, '/');
+    base = with_dir || base == NULL ? manifest : base + 1;
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%lu", index);
+    return path_suffix(base, suffix);
+}
+
+// frees the shards read by manifest_read
+static void manifest_free(Shard *shards, uint64_t count) {
+    for (uint64_t i = 0; i < count; i += 1) {
+        free(shards[i].name);
+    }
+    free(shards);
+}
+
+// reads a manifest written by shard_encrypt_file, returning its shards or NULL
+static Shard *manifest_read(const char *manifest, uint64_t *count) {
+    FILE *file = fopen(manifest, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR MANIFEST %s CANNOT BE OPENED.\n", manifest);
+        return NULL;
+    }
+
+    // "ss-shards count size" followed by one "index start end digest name" line per shard,
+    // '#' starts a comment
+    char line[SHARD_NAME_MAX + 128];
+    uint64_t size = 0;
+    Shard *shards = NULL;
+    uint64_t read = 0;
+    *count = 0;
+    bool ok = false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#') {
+            continue;
+        }
+        if (shards == NULL) {
+            ok = sscanf(line, "ss-shards %lu %lu", count, &size) == 2 && *count > 0;
+            if (!ok) {
+                break;
+            }
+            shards = (Shard *) calloc(*count, sizeof(Shard));
+            continue;
+        }
+
+        uint64_t index;
+        char name[SHARD_NAME_MAX];
+        Shard shard;
+        ok = read < *count
+             && sscanf(line, "%lu %lu %lu %lx %4095[^\n]", &index, &shard.start, &shard.end,
+                    &shard.digest, name)
+                    == 5
+             && index == read && shard.start <= shard.end && shard.end <= size
+             && shard.start == (read == 0 ? 0 : shards[read - 1].end);
+        if (!ok) {
+            break;
+        }
+        shard.name = strdup(name);
+        shards[read] = shard;
+        read += 1;
+    }
+    fclose(file);
+
+    // the shards must cover the whole plaintext
+    if (!ok || read != *count || shards[read - 1].end != size) {
+        fprintf(stderr, "ERROR MANIFEST %s IS NOT VALID.\n", manifest);
+        manifest_free(shards, read);
+        return NULL;
+    }
+    return shards;
+}
+
+// encrypts the plaintext range of one shard into its own file
+static void shard_task(void *arg) {
+    ShardTask *task = (ShardTask *) arg;
+    FILE *infile = fopen(task->inname, "r");
+    FILE *outfile = fopen(task->outpath, "w");
+    char *inbuf = infile != NULL ? profile_setvbuf(infile) : NULL;
+    char *outbuf = outfile != NULL ? profile_setvbuf(outfile) : NULL;
+
+    // digest the plaintext of the range for --merge to check, then encrypt it
+    bool ok = infile != NULL && outfile != NULL && fseeko(infile, task->start, SEEK_SET) == 0;
+    if (ok) {
+        char *buf = (char *) malloc(MERGE_CHUNK);
+        task->digest = HASH_START;
+        ok = digest_file(infile, task->end - task->start, &task->digest, buf)
+             && fseeko(infile, task->start, SEEK_SET) == 0;
+        free(buf);
+    }
+    if (ok) {
+        ss_encrypt_part(infile, outfile, task->n, task->end - task->start);
+        ok = !ferror(infile);
+    }
+    if (infile != NULL) {
+        fclose(infile);
+    }
+    if (outfile != NULL) {
+        ok = fclose(outfile) == 0 && ok;
+    }
+    free(inbuf);
+    free(outbuf);
+
+    if (!ok) {
+        fprintf(stderr, "ERROR SHARD %s CANNOT BE WRITTEN.\n", task->outpath);
+        atomic_store(task->failed, true);
+    }
+}
+
+bool shard_encrypt_file(const char *inname, const char *manifest, const mpz_t n, uint64_t shards,
+    uint64_t threads) {
+    // the ranges are computed from the size, so the input must be a regular file
+    struct stat st;
+    if (stat(inname, &st) != 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "ERROR --shards NEEDS A REGULAR INPUT FILE.\n");
+        return false;
+    }
+    uint64_t size = st.st_size;
+
+    // split the blocks of the file as evenly as possible, k-1 plaintext bytes per block
+    uint64_t k = (mpz_sizeinbase(n, 2) / 2 - 1) / 8;
+    if (k < 2) {
+        fprintf(stderr, "ERROR KEY IS TOO SMALL TO HOLD A PLAINTEXT BYTE PER BLOCK.\n");
+        return false;
+    }
+    uint64_t block = k - 1;
+    uint64_t blocks = (size + block - 1) / block;
+    uint64_t per_shard = (blocks + shards - 1) / shards;
+
+    atomic_bool failed = false;
+    ShardTask *tasks = (ShardTask *) malloc(shards * sizeof(ShardTask));
+    Pool *pool = pool_create(threads);
+    for (uint64_t i = 0; i < shards; i += 1) {
+        uint64_t start = i * per_shard * block, end = (i + 1) * per_shard * block;
+        tasks[i] = (ShardTask) { inname, shard_name(manifest, i, true), n,
+            start < size ? start : size, end < size ? end : size, 0, &failed };
+        pool_submit(pool, shard_task, &tasks[i]);
+    }
+    pool_delete(&pool);
+
+    // the manifest is only written once every shard is complete
+    bool ok = !atomic_load(&failed);
+    if (ok) {
+        FILE *file = fopen(manifest, "w");
+        ok = file != NULL;
+        if (ok) {
+            fprintf(file, "# ss shard manifest: index start end digest file\n");
+            fprintf(file, "ss-shards %lu %lu\n", shards, size);
+            for (uint64_t i = 0; i < shards; i += 1) {
+                char *name = shard_name(manifest, i, false);
+                fprintf(file, "%lu %lu %lu %016lx %s\n", i, tasks[i].start, tasks[i].end,
+                    tasks[i].digest, name);
+                free(name);
+            }
+            ok = fclose(file) == 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "ERROR MANIFEST %s CANNOT BE WRITTEN.\n", manifest);
+        }
+    }
+
+    for (uint64_t i = 0; i < shards; i += 1) {
+        free(tasks[i].outpath);
+    }
+    free(tasks);
+    return ok;
+}
+
+FILE *shard_open(const char *manifest, uint64_t index) {
+    uint64_t count;
+    Shard *shards = manifest_read(manifest, &count);
+    if (shards == NULL) {
+        return NULL;
+    }
+    if (index >= count) {
+        fprintf(stderr, "ERROR MANIFEST %s HAS NO SHARD %lu.\n", manifest, index);
+        manifest_free(shards, count);
+        return NULL;
+    }
+
+    // shard files sit next to the manifest
+    const char *slash = strrchr(manifest, '/');
+    int dir_len = slash == NULL ? 0 : (int) (slash - manifest + 1);
+    size_t len = dir_len + strlen(shards[index].name) + 1;
+    char *path = (char *) malloc(len);
+    snprintf(path, len, "%.*s%s", dir_len, manifest, shards[index].name);
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR SHARD %s CANNOT BE OPENED.\n", path);
+    }
+    free(path);
+    manifest_free(shards, count);
+    return file;
+}
+
+bool shard_merge(const char *manifest, char **parts, uint64_t count, const char *outname) {
+    uint64_t shards_count;
+    Shard *shards = manifest_read(manifest, &shards_count);
+    if (shards == NULL) {
+        return false;
+    }
+    if (count != shards_count) {
+        fprintf(stderr, "ERROR MANIFEST %s NEEDS %lu PARTS, GOT %lu.\n", manifest, shards_count,
+            count);
+        manifest_free(shards, shards_count);
+        return false;
+    }
+
+    // check the length and digest of every part before writing anything
+    bool ok = true;
+    char *buf = (char *) malloc(MERGE_CHUNK);
+    for (uint64_t i = 0; i < count && ok; i += 1) {
+        struct stat st;
+        uint64_t want = shards[i].end - shards[i].start;
+        FILE *part = NULL;
+        uint64_t digest = HASH_START;
+        if (stat(parts[i], &st) != 0 || (part = fopen(parts[i], "r")) == NULL) {
+            fprintf(stderr, "ERROR PART %s CANNOT BE OPENED.\n", parts[i]);
+            ok = false;
+        } else if ((uint64_t) st.st_size != want) {
+            fprintf(stderr, "ERROR PART %s HAS %lu BYTES, SHARD %lu NEEDS %lu.\n", parts[i],
+                (uint64_t) st.st_size, i, want);
+            ok = false;
+        } else if (!digest_file(part, want, &digest, buf) || digest != shards[i].digest) {
+            fprintf(stderr, "ERROR PART %s DOES NOT MATCH SHARD %lu.\n", parts[i], i);
+            ok = false;
+        }
+        if (part != NULL) {
+            fclose(part);
+        }
+    }
+
+    // only now that every part checks out is the output created
+    char *tmpname = outname != NULL ? path_suffix(outname, ".tmp") : NULL;
+    FILE *outfile = stdout;
+    if (ok && tmpname != NULL && (outfile = fopen(tmpname, "w")) == NULL) {
+        fprintf(stderr, "ERROR OUTFILE CANNOT BE OPENED.\n");
+        ok = false;
+    }
+
+    // append the parts in shard order
+    for (uint64_t i = 0; i < count && ok; i += 1) {
+        FILE *part = fopen(parts[i], "r");
+        if (part == NULL) {
+            fprintf(stderr, "ERROR PART %s CANNOT BE OPENED.\n", parts[i]);
+            ok = false;
+            break;
+        }
+        size_t j;
+        while ((j = fread(buf, 1, MERGE_CHUNK, part)) > 0) {
+            if (fwrite(buf, 1, j, outfile) != j) {
+                fprintf(stderr, "ERROR WRITING OUTPUT.\n");
+                ok = false;
+                break;
+            }
+        }
+        fclose(part);
+    }
+
+    // the temporary file replaces the output only when it is complete
+    if (tmpname != NULL && outfile != NULL) {
+        if (fclose(outfile) != 0 && ok) {
+            fprintf(stderr, "ERROR WRITING OUTPUT.\n");
+            ok = false;
+        }
+        if (ok && rename(tmpname, outname) != 0) {
+            fprintf(stderr, "ERROR WRITING OUTPUT.\n");
+            ok = false;
+        }
+        if (!ok) {
+            unlink(tmpname);
+        }
+    } else if (fflush(stdout) != 0 && ok) {
+        fprintf(stderr, "ERROR WRITING OUTPUT.\n");
+        ok = false;
+    }
+
+    free(tmpname);
+    free(buf);
+    manifest_free(shards, shards_count);
+    return ok;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdio.h>
+#include <gmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Encrypt a file into independent shards
+//
+// Provides:
+//  writes "<manifest>.0" to "<manifest>.<shards-1>", each holding what ss_encrypt_file writes
+//  for one contiguous range of the plaintext, and a manifest recording the plaintext offset
+//  range and a digest of the plaintext of every shard
+//
+// The ranges are split on block boundaries, so the shards together hold exactly the blocks
+// of encrypting the whole file and each one can be decrypted on its own. The shards are
+// encrypted on a pool of "threads" threads.
+//
+// Requires:
+//  inname: regular file to encrypt
+//  manifest: path of the manifest to write
+//  n: public exponent and modulus, with blocks of at least 2 bytes
+//  shards: number of shards, at least 1
+//  threads: number of worker threads
+//
+// Returns false if the key is too small or a file could not be read or written.
+//
+bool shard_encrypt_file(const char *inname, const char *manifest, const mpz_t n, uint64_t shards,
+    uint64_t threads);
+
+//
+// Opens one shard named by a manifest for reading.
+// Shard files are looked up in the directory of the manifest.
+//
+// Returns NULL if the manifest cannot be read, has no such shard, or the shard cannot be opened.
+//
+FILE *shard_open(const char *manifest, uint64_t index);
+
+//
+// Reassembles a plaintext from the decrypted shards of a manifest.
+//
+// Requires:
+//  manifest: manifest written by shard_encrypt_file
+//  parts: decrypted shards, one per shard in manifest order
+//  count: number of parts, which must equal the number of shards
+//  outname: file to write, or NULL for stdout
+//
+// The plaintext is written to <outname>.tmp and renamed over outname once it is complete,
+// so an existing outname, which may be one of the parts, is left alone on failure.
+//
+// Returns false, before writing anything, if a part is missing or its length or digest
+// differs from its shard, and false if the output cannot be written.
+//
+bool shard_merge(const char *manifest, char **parts, uint64_t count, const char *outname);
@@ -3,17 +3,23 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
+#include "arena.h"
+#include "backend.h"
 #include "numtheory.h"
+#include "pool.h"
+#include "profile.h"
 #include "randstate.h"
 #include "ss.h"
 
 // lcm function created using https://discord.com/channels/1035678172856995900/1061813507164733460/1077811448538992750 equation: lcm(a, b)=|ab|/gcd(a,b)
 // where a = (p-1) and b = (q-1)
 void lcm(mpz_t s, mpz_t a, mpz_t b) {
-    // create all necessary mpz variables
-    mpz_t mul_ab, pos_numerator, num, denom, divs;
-    mpz_inits(mul_ab, pos_numerator, num, denom, divs, NULL);
+    Arena *arena = arena_get();
+    mpz_ptr mul_ab = arena->lcm_mul_ab, pos_numerator = arena->lcm_pos_numerator,
+            num = arena->lcm_num, denom = arena->lcm_denom, divs = arena->lcm_divs;
 
     // create the numerator which is absolute value of a * b
     mpz_mul(mul_ab, a, b);
@@ -21,47 +27,129 @@ void lcm(mpz_t s, mpz_t a, mpz_t b) {
     mpz_set(num, pos_numerator);
 
     // solve for the denominator which is the gcd of a and b
-    gcd(denom, a, b);
+    backend->gcd(denom, a, b);
     mpz_fdiv_q(divs, num, denom);
 
     // set the division of num and denom to the variable s
     mpz_set(s, divs);
+}
 
-    // clear all variables
-    mpz_clears(mul_ab, pos_numerator, num, denom, divs, NULL);
+PubStats pub_stats;
+
+// fewest and most small odd primes sieved out and number of odd candidates in one sieve window
+// larger candidates sieve more primes, since every survivor costs a full exponentiation
+#define SIEVE_PRIMES 300
+#define SIEVE_MAX_PRIMES 8192
+#define SIEVE_WINDOW 4096
+
+// Finds a prime in [2^bits, 2^(bits+1)) like make_prime, but tests only candidates surviving a sieve.
+// The sieve strikes out multiples of small primes. When "q_minus_one" is given, candidates that
+// divide it are passed over before their primality test.
+static void sieve_prime(mpz_t p, uint64_t bits, uint64_t iters, mpz_srcptr q_minus_one) {
+    mpz_t base, limit, cand;
+    mpz_inits(base, limit, cand, NULL);
+
+    // collect the first bits/2 odd primes by trial division, within the limits above
+    uint64_t sieve_primes = bits / 2;
+    sieve_primes = sieve_primes < SIEVE_PRIMES ? SIEVE_PRIMES : sieve_primes;
+    sieve_primes = sieve_primes > SIEVE_MAX_PRIMES ? SIEVE_MAX_PRIMES : sieve_primes;
+    uint32_t primes[SIEVE_MAX_PRIMES];
+    uint64_t count = 0;
+    for (uint32_t v = 3; count < sieve_primes; v += 2) {
+        bool prime = true;
+        for (uint64_t i = 0; i < count && primes[i] * primes[i] <= v; i += 1) {
+            if (v % primes[i] == 0) {
+                prime = false;
+                break;
+            }
+        }
+        if (prime) {
+            primes[count] = v;
+            count += 1;
+        }
+    }
+
+    // candidates must stay below 2^(bits+1)
+    mpz_ui_pow_ui(limit, 2, bits + 1);
+
+    bool composite[SIEVE_WINDOW];
+    bool found = false;
+    while (!found) {
+        // draw a random odd start for the window the same way make_prime draws its candidates
+        pub_stats.windows += 1;
+        rand_urandomb(base, bits);
+        mpz_setbit(base, bits);
+        mpz_setbit(base, 0);
+
+        // candidate j of the window is base + 2j
+        for (int j = 0; j < SIEVE_WINDOW; j += 1) {
+            composite[j] = false;
+        }
+
+        // base + 2j is divisible by sp when j = -base/2 (mod sp)
+        for (uint64_t i = 0; i < sieve_primes; i += 1) {
+            uint32_t sp = primes[i];
+            // a candidate equal to sp is prime, so only sieve primes below the window
+            if (mpz_cmp_ui(base, sp) <= 0) {
+                continue;
+            }
+            uint64_t r = mpz_fdiv_ui(base, sp);
+            uint64_t j = ((sp - r) % sp) * ((sp + 1) / 2) % sp;
+            for (; j < SIEVE_WINDOW; j += sp) {
+                composite[j] = true;
+            }
+        }
+
+        // run Miller-Rabin only on the survivors
+        for (int j = 0; j < SIEVE_WINDOW && !found; j += 1) {
+            if (composite[j]) {
+                pub_stats.sieved += 1;
+                continue;
+            }
+            mpz_add_ui(cand, base, 2 * j);
+            if (mpz_cmp(cand, limit) >= 0) {
+                break;
+            }
+            // a p dividing q-1 makes the key unusable, and one division is far cheaper than
+            // the test
+            if (q_minus_one != NULL && mpz_divisible_p(q_minus_one, cand) != 0) {
+                pub_stats.retries += 1;
+                continue;
+            }
+            pub_stats.prime_tests += 1;
+            if (backend->is_prime(cand, iters)) {
+                mpz_set(p, cand);
+                found = true;
+            }
+        }
+    }
+
+    mpz_clears(base, limit, cand, NULL);
 }
 
 // Creates parts of a new SS public key: two large primes p and q, and n computed as p∗p∗q
 void ss_make_pub(mpz_t p, mpz_t q, mpz_t n, uint64_t nbits, uint64_t iters) {
     // initialize all mpz variables
-    mpz_t p_minus_one, q_minus_one, p_squared;
-    mpz_inits(p_minus_one, q_minus_one, p_squared, NULL);
+    mpz_t q_minus_one, p_squared;
+    mpz_inits(q_minus_one, p_squared, NULL);
     // create the range of bits to input in p and q
     uint64_t pbits = random() % ((2 * nbits) / 5 + 1 - (nbits / 5)) + (nbits / 5);
     uint64_t qbits = nbits - pbits;
 
-    // create variables for p-1 and q-1
-    mpz_sub_ui(p_minus_one, p, 1);
-    mpz_sub_ui(q_minus_one, q, 1);
-
-    // check divisibility, if so you must generate new primes
-    make_prime(p, pbits, iters);
-    make_prime(q, qbits, iters);
-
-    while (mpz_divisible_p(p, q_minus_one) == 0 || mpz_divisible_p(q, p_minus_one) == 0) {
-        make_prime(p, pbits, iters);
-        make_prime(q, qbits, iters);
+    pub_stats = (PubStats) { 0 };
 
-        mpz_sub_ui(p_minus_one, p, 1);
-        mpz_sub_ui(q_minus_one, q, 1);
-    }
+    // q is found first, then p is searched among the candidates that do not divide q-1.
+    // qbits > pbits puts p below q, so p != q and q cannot divide p-1 either.
+    sieve_prime(q, qbits, iters, NULL);
+    mpz_sub_ui(q_minus_one, q, 1);
+    sieve_prime(p, pbits, iters, q_minus_one);
 
     // update value "n" as p*p*q
     mpz_mul(p_squared, p, p);
     mpz_mul(n, p_squared, q);
 
     // clear all mpz_variables
-    mpz_clears(p_minus_one, q_minus_one, p_squared, NULL);
+    mpz_clears(q_minus_one, p_squared, NULL);
 }
 
 // Creates a new SS private key d given primes p and q and the public key n
@@ -81,7 +169,7 @@ void ss_make_priv(mpz_t d, mpz_t pq, const mpz_t p, const mpz_t q) {
 
     // provide the private modulus and exponent
     mpz_mul(pq, p, q);
-    mod_inverse(d, n, lambda_pq);
+    backend->mod_inverse(d, n, lambda_pq);
 
     // clear all variables
     mpz_clears(p_squared, n, p_minus_one, q_minus_one, lambda_pq, NULL);
@@ -126,12 +214,49 @@ void ss_read_priv(mpz_t pq, mpz_t d, FILE *pvfile) {
     gmp_fscanf(pvfile, "%Zx\n", d);
 }
 
+Cache *encrypt_cache = NULL;
+Cache *decrypt_cache = NULL;
+
+// keys are padded plaintext blocks, values the ciphertext hex digits
+void ss_cache_encrypt(uint64_t entries, const mpz_t n) {
+    size_t k = (mpz_sizeinbase(n, 2) / 2 - 1) / 8;
+    encrypt_cache = cache_create(entries, k, mpz_sizeinbase(n, 16) + 1);
+}
+
+// keys are ciphertext hex digits, values the plaintext bytes; a ciphertext is below
+// n = p*p*q < (pq)^2 so it has at most twice the hex digits of pq
+void ss_cache_decrypt(uint64_t entries, const mpz_t pq) {
+    size_t k = (mpz_sizeinbase(pq, 2) - 1) / 8;
+    decrypt_cache = cache_create(entries, 2 * mpz_sizeinbase(pq, 16) + 2, k);
+}
+
 // performs SS encryption using formula E(m) = c = m^n (mod n)
 void ss_encrypt(mpz_t c, const mpz_t m, const mpz_t n) {
-    pow_mod(c, m, n, n);
+    backend->pow_mod(c, m, n, n);
 }
 
-void ss_encrypt_file(FILE *infile, FILE *outfile, const mpz_t n) {
+size_t ss_encrypt_block(char *hex, const uint8_t *block, size_t len, const mpz_t n, mpz_t c, mpz_t m) {
+    // a block seen before has the same ciphertext, skip the exponentiation
+    uint64_t hex_len;
+    if (encrypt_cache != NULL && cache_get(encrypt_cache, block, len, (uint8_t *) hex, &hex_len)) {
+        hex[hex_len] = '\0';
+        return hex_len;
+    }
+
+    mpz_import(m, len, 1, sizeof(block[0]), 1, 0,
+        block); // 1=most significant word first, 1=endian, and 0=nails
+    ss_encrypt(c, m, n);
+    // convert to hex without gmp_fprintf's per call allocation
+    mpz_get_str(hex, 16, c);
+    hex_len = strlen(hex);
+    if (encrypt_cache != NULL) {
+        cache_put(encrypt_cache, block, len, (uint8_t *) hex, hex_len);
+    }
+    return hex_len;
+}
+
+// encrypts at most "len" bytes of infile, the body of ss_encrypt_file and ss_encrypt_part
+static void encrypt_blocks(FILE *infile, FILE *outfile, const mpz_t n, Journal *journal, uint64_t len) {
     // calculate the block size k
     size_t k = (mpz_sizeinbase(n, 2) / 2 - 1) / 8;
 
@@ -141,6 +266,9 @@ void ss_encrypt_file(FILE *infile, FILE *outfile, const mpz_t n) {
     // set the zeroth byte of the block to 0xFF
     arr_block[0] = 0xFF;
 
+    // room for the hex digits of a ciphertext, reused for every block
+    char *hex = (char *) malloc(mpz_sizeinbase(n, 16) + 2);
+
     // initialize mpz variables to be used for encryting
     mpz_t c, m;
     mpz_inits(c, m, NULL);
@@ -150,26 +278,77 @@ void ss_encrypt_file(FILE *infile, FILE *outfile, const mpz_t n) {
         size_t j;
 
         // read at most k-1 bytes from infile and place read bytes into allocated block starting from array 1
-        while ((j = fread(arr_block + 1, sizeof(uint8_t), k - 1, infile)) > 0) {
-            mpz_import(m, j + 1, 1, sizeof(arr_block[0]), 1, 0,
-                arr_block); // 1=most significant word first, 1=endian, and 0=nails
-            ss_encrypt(c, m, n);
+        while (len > 0
+               && (j = fread(arr_block + 1, sizeof(uint8_t), len < k - 1 ? len : k - 1, infile))
+                      > 0) {
+            len -= j;
+
             // write the encrypted number to outfile
-            gmp_fprintf(outfile, "%Zx\n", c);
+            size_t hex_len = ss_encrypt_block(hex, arr_block, j + 1, n, c, m);
+            fputs(hex, outfile);
+            fputc('\n', outfile);
+
+            // record the finished block so an interrupted run can resume after it
+            if (journal != NULL) {
+                journal_step(journal, outfile, j, hex_len + 1);
+            }
         }
     }
 
-    // clear all variables and free the array created
+    // clear all variables and free the arrays created
     mpz_clears(c, m, NULL);
     free(arr_block);
+    free(hex);
+}
+
+void ss_encrypt_file(FILE *infile, FILE *outfile, const mpz_t n, Journal *journal) {
+    encrypt_blocks(infile, outfile, n, journal, UINT64_MAX);
+}
+
+void ss_encrypt_part(FILE *infile, FILE *outfile, const mpz_t n, uint64_t len) {
+    encrypt_blocks(infile, outfile, n, NULL, len);
 }
 
 // performs SS decryption using the formula s D(c) = m = c^d (mod pq)
 void ss_decrypt(mpz_t m, const mpz_t c, const mpz_t d, const mpz_t pq) {
-    pow_mod(m, c, d, pq);
+    backend->pow_mod(m, c, d, pq);
 }
 
-void ss_decrypt_file(FILE *infile, FILE *outfile, const mpz_t d, const mpz_t pq) {
+size_t ss_decrypt_block(uint8_t *block, const char *line, size_t line_len, const mpz_t d, const mpz_t pq,
+    mpz_t c, mpz_t m) {
+    // the hex digits without the line ending key the cache
+    while (line_len > 0 && (line[line_len - 1] == '\n' || line[line_len - 1] == '\r')) {
+        line_len -= 1;
+    }
+
+    // a ciphertext seen before has the same plaintext, skip the exponentiation
+    uint64_t hit_len;
+    if (decrypt_cache != NULL
+        && cache_get(decrypt_cache, (const uint8_t *) line, line_len, block + 1, &hit_len)) {
+        return hit_len;
+    }
+
+    // skip anything that is not a hex number, such as blank lines
+    if (mpz_set_str(c, line, 16) != 0) {
+        return 0;
+    }
+
+    // decrypt c back to its original value m
+    ss_decrypt(m, c, d, pq);
+
+    // convert m back into bytes, the plaintext follows the padding byte
+    size_t j;
+    mpz_export(block, &j, 1, sizeof(uint8_t), 1, 0, m);
+    if (j <= 1) {
+        return 0;
+    }
+    if (decrypt_cache != NULL) {
+        cache_put(decrypt_cache, (const uint8_t *) line, line_len, block + 1, j - 1);
+    }
+    return j - 1;
+}
+
+void ss_decrypt_file(FILE *infile, FILE *outfile, const mpz_t d, const mpz_t pq, Journal *journal) {
     // initialize all mpz variables
     mpz_t c, m;
     mpz_inits(c, m, NULL);
@@ -177,23 +356,213 @@ void ss_decrypt_file(FILE *infile, FILE *outfile, const mpz_t d, const mpz_t pq)
     // solve for k
     size_t k = (mpz_sizeinbase(pq, 2) - 1) / 8;
 
-    // Dynamically allocate an array that can hold k bytes
-    uint8_t *arr_block = (uint8_t *) calloc(k, sizeof(uint8_t));
+    // Dynamically allocate an array that can hold any number below pq, which is up to
+    // k + 1 bytes, so cached blocks of k bytes also fit after the padding byte
+    uint8_t *arr_block = (uint8_t *) calloc(k + 1, sizeof(uint8_t));
 
-    size_t j;
-    while (gmp_fscanf(infile, "%Zx\n", c) != EOF) {
-        // decrypt c back to its original value m
-        ss_decrypt(m, c, d, pq);
+    // line buffer reused for every block instead of gmp_fscanf's per call allocation
+    char *line = NULL;
+    size_t line_cap = 0;
 
-        // convert m back into bytes storing in allocated block
-
-        mpz_export(arr_block, &j, 1, sizeof(uint8_t), 1, 0, m);
+    ssize_t line_len;
+    while ((line_len = getline(&line, &line_cap, infile)) > 0) {
+        // write the plaintext bytes, starting from index 1 after the padding byte
+        size_t j = ss_decrypt_block(arr_block, line, line_len, d, pq, c, m);
+        if (j > 0) {
+            fwrite(&arr_block[1], sizeof(uint8_t), j, outfile);
+        }
 
-        // write j-1 from array of blocks starting from index 1
-        fwrite(&arr_block[1], sizeof(uint8_t), j - 1, outfile);
+        // record the finished block so an interrupted run can resume after it,
+        // counting whole lines of input
+        if (journal != NULL) {
+            journal_step(journal, outfile, line_len, j);
+        }
     }
 
-    // clear all variables and free the array created
+    // clear all variables and free the arrays created
     free(arr_block);
+    free(line);
     mpz_clears(c, m, NULL);
 }
+
+// one slice of a batch: every "stride"-th number starting at "start"
+typedef struct {
+    mpz_t *out; // results of the batch
+    mpz_t *in; // inputs of the batch
+    size_t count; // number of blocks in the batch
+    size_t start; // first block this task handles
+    size_t stride; // number of tasks sharing the batch
+    mpz_srcptr e; // exponent to raise each input to
+    mpz_srcptr mod; // modulus of the exponentiation
+} ReencryptTask;
+
+// decrypts or encrypts one slice of a batch
+static void reencrypt_task(void *arg) {
+    ReencryptTask *task = (ReencryptTask *) arg;
+    for (size_t i = task->start; i < task->count; i += task->stride) {
+        backend->pow_mod(task->out[i], task->in[i], task->e, task->mod);
+    }
+}
+
+// queues the numbers of "in" raised to "e" modulo "mod" on the pool without waiting for them,
+// "tasks" must hold "threads" entries and stay alive until pool_wait
+static void reencrypt_submit(Pool *pool, ReencryptTask *tasks, uint64_t threads, mpz_t *out,
+    mpz_t *in, size_t count, const mpz_t e, const mpz_t mod) {
+    // spread the blocks round robin so every thread gets the same amount of work
+    for (uint64_t t = 0; t < threads; t += 1) {
+        tasks[t] = (ReencryptTask) { out, in, count, t, threads, e, mod };
+        pool_submit(pool, reencrypt_task, &tasks[t]);
+    }
+}
+
+// reads up to "batch" ciphertext lines into "c", returning how many were numbers
+static size_t reencrypt_read(FILE *infile, mpz_t *c, size_t batch, char **line, size_t *line_cap) {
+    size_t count = 0;
+    while (count < batch && getline(line, line_cap, infile) > 0) {
+        if (mpz_set_str(c[count], *line, 16) == 0) {
+            count += 1;
+        }
+    }
+    return count;
+}
+
+void ss_reencrypt_file(FILE *infile, FILE *outfile, const mpz_t d, const mpz_t pq, const mpz_t n,
+    uint64_t threads) {
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // block size of the old key as used by ss_decrypt_file and of the new key as used by ss_encrypt_file
+    size_t k_old = (mpz_sizeinbase(pq, 2) - 1) / 8;
+    size_t k_new = (mpz_sizeinbase(n, 2) / 2 - 1) / 8;
+
+    // number of old blocks decrypted together and the most new blocks they can turn into
+    size_t batch = threads * profile.batch;
+    size_t max_new = (batch * k_old + k_new) / (k_new - 1) + 1;
+
+    // the workers live for the whole file so their arenas are reused by every batch
+    Pool *pool = pool_create(threads);
+    // on the heap, threads comes from the user and may be far larger than a stack frame
+    ReencryptTask *decrypt_tasks = (ReencryptTask *) malloc(threads * sizeof(ReencryptTask));
+    ReencryptTask *encrypt_tasks = (ReencryptTask *) malloc(threads * sizeof(ReencryptTask));
+
+    // room for the hex digits of a ciphertext and a line of input
+    char *hex = (char *) malloc(mpz_sizeinbase(n, 16) + 2);
+    char *line = NULL;
+    size_t line_cap = 0;
+
+    // numbers of the old (c, m) and new (c2, m2) key, two sets so one batch can be read or
+    // written while the pool works on the other
+    mpz_t *c[2], *m[2], *c2[2], *m2[2];
+    size_t count[2] = { 0, 0 }, count_new[2] = { 0, 0 };
+    for (int s = 0; s < 2; s += 1) {
+        c[s] = (mpz_t *) malloc(batch * sizeof(mpz_t));
+        m[s] = (mpz_t *) malloc(batch * sizeof(mpz_t));
+        c2[s] = (mpz_t *) malloc(max_new * sizeof(mpz_t));
+        m2[s] = (mpz_t *) malloc(max_new * sizeof(mpz_t));
+        for (size_t i = 0; i < batch; i += 1) {
+            mpz_inits(c[s][i], m[s][i], NULL);
+        }
+        for (size_t i = 0; i < max_new; i += 1) {
+            mpz_inits(c2[s][i], m2[s][i], NULL);
+        }
+    }
+
+    // the decrypted bytes waiting to be cut into blocks of the new key, this never leaves memory
+    uint8_t *pending = (uint8_t *) calloc(batch * k_old + k_new, sizeof(uint8_t));
+    size_t pending_len = 0;
+
+    // buffer to export an old block into and the 0xFF padded block of the new key
+    uint8_t *arr_old = (uint8_t *) calloc(mpz_sizeinbase(pq, 256) + 1, sizeof(uint8_t));
+    uint8_t *arr_new = (uint8_t *) calloc(k_new, sizeof(uint8_t));
+    arr_new[0] = 0xFF;
+
+    // Batch i goes through four steps: read, decrypt, encrypt and write. In round i the pool
+    // decrypts batch i and encrypts the new blocks of batch i-1 while this thread writes the
+    // ciphertext of batch i-2 and reads batch i+1, so the I/O hides behind the arithmetic.
+    // "last" is the index of the final batch once the input has run out.
+    uint64_t last = UINT64_MAX;
+    count[0] = reencrypt_read(infile, c[0], batch, &line, &line_cap);
+    if (count[0] < batch) {
+        last = 0;
+    }
+    for (uint64_t i = 0; last == UINT64_MAX || i <= last + 2; i += 1) {
+        size_t cur = i % 2, prev = 1 - cur;
+
+        // decrypt batch i with the old private key and encrypt the blocks cut from batch i-1
+        // under the new public key
+        if (i <= last) {
+            reencrypt_submit(pool, decrypt_tasks, threads, m[cur], c[cur], count[cur], d, pq);
+        }
+        if (i >= 1 && i - 1 <= last) {
+            reencrypt_submit(
+                pool, encrypt_tasks, threads, c2[prev], m2[prev], count_new[prev], n, n);
+        }
+
+        // meanwhile write out batch i-2, which was encrypted last round, and read batch i+1
+        if (i >= 2) {
+            for (size_t j = 0; j < count_new[cur]; j += 1) {
+                mpz_get_str(hex, 16, c2[cur][j]);
+                fputs(hex, outfile);
+                fputc('\n', outfile);
+            }
+        }
+        if (last == UINT64_MAX) {
+            count[prev] = reencrypt_read(infile, c[prev], batch, &line, &line_cap);
+            if (count[prev] < batch) {
+                last = i + 1;
+            }
+        }
+        pool_wait(pool);
+        if (i > last) {
+            continue;
+        }
+
+        // strip the 0xFF padding of each old block of batch i and queue the bytes
+        for (size_t j = 0; j < count[cur]; j += 1) {
+            size_t len = 0;
+            mpz_export(arr_old, &len, 1, sizeof(uint8_t), 1, 0, m[cur][j]);
+            if (len > 1) {
+                memcpy(pending + pending_len, arr_old + 1, len - 1);
+                pending_len += len - 1;
+            }
+        }
+
+        // cut the queued bytes into blocks of the new key, keeping the tail for the next batch
+        // unless this is the last one
+        bool eof = i == last;
+        size_t used = 0;
+        count_new[cur] = 0;
+        while (pending_len - used >= k_new - 1 || (eof && used < pending_len)) {
+            size_t len = pending_len - used < k_new - 1 ? pending_len - used : k_new - 1;
+            memcpy(arr_new + 1, pending + used, len);
+            mpz_import(m2[cur][count_new[cur]], len + 1, 1, sizeof(arr_new[0]), 1, 0, arr_new);
+            used += len;
+            count_new[cur] += 1;
+        }
+        memmove(pending, pending + used, pending_len - used);
+        pending_len -= used;
+    }
+
+    // stop the workers, clear all variables and free the arrays created
+    pool_delete(&pool);
+    for (int s = 0; s < 2; s += 1) {
+        for (size_t i = 0; i < batch; i += 1) {
+            mpz_clears(c[s][i], m[s][i], NULL);
+        }
+        for (size_t i = 0; i < max_new; i += 1) {
+            mpz_clears(c2[s][i], m2[s][i], NULL);
+        }
+        free(c[s]);
+        free(m[s]);
+        free(c2[s]);
+        free(m2[s]);
+    }
+    free(decrypt_tasks);
+    free(encrypt_tasks);
+    free(pending);
+    free(arr_old);
+    free(arr_new);
+    free(hex);
+    free(line);
+}
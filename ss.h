@@ -5,6 +5,21 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "cache.h"
+#include "journal.h"
+
+//
+// Work done by the last call to ss_make_pub.
+//
+typedef struct {
+    uint64_t windows; // sieve windows of candidates drawn
+    uint64_t sieved; // candidates ruled out by the sieve without a primality test
+    uint64_t prime_tests; // Miller-Rabin primality tests run
+    uint64_t retries; // candidates for p passed over because they divide q-1
+} PubStats;
+
+extern PubStats pub_stats;
+
 //
 // Generates the components for a new SS key.
 //
@@ -13,6 +28,10 @@
 //  q: second prime
 //  n: public modulus/exponent
 //
+// q is searched first. p has fewer bits, so it is below q and q never divides p-1; the only
+// bad pairing left, p dividing q-1, is ruled out by skipping such candidates for p before
+// their primality test. The work done is recorded in pub_stats.
+//
 // Requires:
 //  nbits: minimum # of bits in n
 //  iters: iterations of Miller-Rabin to use for primality check
@@ -94,6 +113,41 @@ void ss_read_priv(mpz_t pq, mpz_t d, FILE *pvfile);
 //
 void ss_encrypt(mpz_t c, const mpz_t m, const mpz_t n);
 
+//
+// Optional memoization of whole blocks. SS encryption is deterministic, so identical
+// plaintext blocks (zero filled or repeated regions) always give identical ciphertext.
+// When set, the file encryption paths look each padded plaintext block up in
+// encrypt_cache before calling ss_encrypt, and the file decryption paths look each
+// ciphertext line up in decrypt_cache before calling ss_decrypt. NULL disables them.
+//
+extern Cache *encrypt_cache;
+extern Cache *decrypt_cache;
+
+//
+// Creates encrypt_cache with room for "entries" blocks of the public key n.
+//
+void ss_cache_encrypt(uint64_t entries, const mpz_t n);
+
+//
+// Creates decrypt_cache with room for "entries" blocks of the private modulus pq.
+//
+void ss_cache_decrypt(uint64_t entries, const mpz_t pq);
+
+//
+// Encrypt one padded plaintext block, through encrypt_cache when it is set
+//
+// Provides:
+//  hex: the hex digits of the ciphertext, NUL terminated
+//  returns the number of hex digits
+//
+// Requires:
+//  block: "len" bytes starting with the 0xFF padding byte, at most k bytes of the key
+//  hex: room for mpz_sizeinbase(n, 16) + 2 characters
+//  n: public exponent and modulus
+//  c, m: initialized scratch variables
+//
+size_t ss_encrypt_block(char *hex, const uint8_t *block, size_t len, const mpz_t n, mpz_t c, mpz_t m);
+
 //
 // Encrypt an arbitrary file
 //
@@ -104,8 +158,24 @@ void ss_encrypt(mpz_t c, const mpz_t m, const mpz_t n);
 //  infile: open and readable file stream
 //  outfile: open and writable file stream
 //  n: public exponent and modulus
+//  journal: checkpoint journal to record each block in, or NULL
+//
+void ss_encrypt_file(FILE *infile, FILE *outfile, const mpz_t n, Journal *journal);
+
+//
+// Encrypt part of a file
+//
+// Provides:
+//  fills outfile with what ss_encrypt_file writes, but for only the next len bytes of infile
+//
+// Requires:
+//  infile: open and readable file stream, positioned at the start of the part
+//  outfile: open and writable file stream
+//  n: public exponent and modulus
+//  len: bytes to encrypt, a multiple of the k-1 plaintext bytes of a block unless the part
+//       runs to the end of the file, so that the parts line up with the blocks of the whole file
 //
-void ss_encrypt_file(FILE *infile, FILE *outfile, const mpz_t n);
+void ss_encrypt_part(FILE *infile, FILE *outfile, const mpz_t n, uint64_t len);
 
 //
 // Decrypt number c into number m
@@ -121,6 +191,23 @@ void ss_encrypt_file(FILE *infile, FILE *outfile, const mpz_t n);
 //
 void ss_decrypt(mpz_t m, const mpz_t c, const mpz_t d, const mpz_t pq);
 
+//
+// Decrypt one ciphertext line, through decrypt_cache when it is set
+//
+// Provides:
+//  block: the plaintext bytes from index 1 on, after the padding byte
+//  returns the number of plaintext bytes, 0 for a line that is not a hex number
+//
+// Requires:
+//  block: room for k + 1 bytes of the key
+//  line: NUL terminated hex digits, possibly followed by a line ending within line_len
+//  d: private exponent
+//  pq: private modulus
+//  c, m: initialized scratch variables
+//
+size_t ss_decrypt_block(uint8_t *block, const char *line, size_t line_len, const mpz_t d, const mpz_t pq,
+    mpz_t c, mpz_t m);
+
 //
 // Decrypt a file back into its original form.
 //
@@ -132,5 +219,26 @@ void ss_decrypt(mpz_t m, const mpz_t c, const mpz_t d, const mpz_t pq);
 //  outfile: open and writable file stream
 //  d: private exponent
 //  pq: private modulus
+//  journal: checkpoint journal to record each line in, or NULL
+//
+void ss_decrypt_file(FILE *infile, FILE *outfile, const mpz_t d, const mpz_t pq, Journal *journal);
+
+//
+// Re-encrypt a file from one SS key pair to another without writing plaintext anywhere.
+//
+// Provides:
+//  fills outfile with what ss_encrypt_file would write for the plaintext of infile
+//
+// Requires:
+//  infile: open and readable file stream to data encrypted under the old key
+//  outfile: open and writable file stream
+//  d: private exponent of the old key
+//  pq: private modulus of the old key
+//  n: public exponent and modulus of the new key
+//  threads: number of threads to decrypt and encrypt blocks with
+//
+// The blocks are processed in batches. While the threads decrypt one batch and encrypt the
+// previous one, the calling thread writes the batch before that and reads the next one.
 //
-void ss_decrypt_file(FILE *infile, FILE *outfile, const mpz_t d, const mpz_t pq);
+void ss_reencrypt_file(FILE *infile, FILE *outfile, const mpz_t d, const mpz_t pq, const mpz_t n,
+    uint64_t threads);
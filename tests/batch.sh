@@ -0,0 +1,30 @@
+#!/bin/sh
+# Directory mode with the output directory inside the input tree and a symbolic link loop.
+# Run from the repository root after building, or with "make check".
+set -e
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+./keygen -b 512 -s 1 -n "$dir/key.pub" -d "$dir/key.priv"
+
+mkdir -p "$dir/tree/sub"
+head -c 5000 /dev/urandom > "$dir/tree/a"
+head -c 300 /dev/urandom > "$dir/tree/sub/b"
+ln -s .. "$dir/tree/sub/up"
+
+# -O inside -r: the walk must skip the directory it is writing into
+timeout 60 ./encrypt -n "$dir/key.pub" -r "$dir/tree" -O "$dir/tree/out" -t 2
+test ! -e "$dir/tree/out/out"
+test ! -e "$dir/tree/out/sub/up"
+timeout 60 ./decrypt -n "$dir/key.priv" -r "$dir/tree/out" -O "$dir/plain" -t 2
+cmp "$dir/tree/a" "$dir/plain/a"
+cmp "$dir/tree/sub/b" "$dir/plain/sub/b"
+
+# -O equal to -r is refused
+if ./encrypt -n "$dir/key.pub" -r "$dir/tree" -O "$dir/tree" 2>/dev/null; then
+    echo "FAIL: -O equal to -r was accepted"
+    exit 1
+fi
+
+echo "batch: ok"
@@ -0,0 +1,294 @@
+#include "arena.h"
+#include "backend.h"
+#include "numtheory.h"
+#include "profile.h"
+#include "randstate.h"
+#include "ss.h"
+
+#include <gmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define OPTIONS "b:o:s:B:vh"
+
+// key sizes tuned when -b is not given
+static const uint64_t key_sizes[] = { 1024, 2048, 3072, 4096 };
+
+// candidate values tried for each parameter
+static const uint64_t batches[] = { 16, 32, 64, 128 };
+
+// blocks in the sample files, small enough to keep 4096 bit passes short
+#define SAMPLE_BLOCKS 16
+
+void usage(char *exec) {
+    fprintf(stderr,
+        "SYNOPSIS\n"
+        "   Measures the best SS parameters for this host and writes a tuning profile\n"
+        "   that keygen, encrypt, decrypt and reencrypt load at startup.\n"
+        "\n"
+        "USAGE\n"
+        "   %s [-hv] [-b bits] [-o profile] [-s seed] [-B backend]\n"
+        "\n"
+        "OPTIONS\n"
+        "   -h              Display program help and usage.\n"
+        "   -v              Display every measurement.\n"
+        "   -b bits         Tune only this key size (default: 1024, 2048, 3072 and 4096).\n"
+        "   -o profile      Profile to write (default: ~/.ss_tune).\n"
+        "   -s seed         Random seed for the calibration keys and data.\n"
+        "   -B backend      Arithmetic backend to tune: ref, fast, gmp, gmp-sec or check\n"
+        "                   (default: $SS_BACKEND, else fast).\n",
+        exec);
+}
+
+// seconds on the monotonic clock
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a temporary file holding "data" with the current profile's stdio buffer, rewound
+static FILE *sample_file(const char *data, size_t len, char **buf) {
+    FILE *file = tmpfile();
+    *buf = profile_setvbuf(file);
+    if (len > 0) {
+        fwrite(data, 1, len, file);
+        rewind(file);
+    }
+    return file;
+}
+
+// times ss_encrypt_file and ss_decrypt_file on the sample, or returns -1 if the round trip fails
+static double time_files(const char *plain, size_t len, const mpz_t n, const mpz_t d, const mpz_t pq) {
+    char *in_buf, *ct_buf, *out_buf;
+    FILE *infile = sample_file(plain, len, &in_buf);
+    FILE *ctfile = sample_file(NULL, 0, &ct_buf);
+    FILE *outfile = sample_file(NULL, 0, &out_buf);
+
+    double start = now();
+    ss_encrypt_file(infile, ctfile, n, NULL);
+    fflush(ctfile);
+    rewind(ctfile);
+    ss_decrypt_file(ctfile, outfile, d, pq, NULL);
+    fflush(outfile);
+    double elapsed = now() - start;
+
+    // make sure the parameters did not break anything
+    char *check = (char *) malloc(len + 1);
+    rewind(outfile);
+    if (fread(check, 1, len + 1, outfile) != len || memcmp(check, plain, len) != 0) {
+        elapsed = -1;
+    }
+
+    free(check);
+    fclose(infile);
+    fclose(ctfile);
+    fclose(outfile);
+    free(in_buf);
+    free(ct_buf);
+    free(out_buf);
+    return elapsed;
+}
+
+// times "reps" calls of the backend's pow_mod with the private exponent
+static double time_pow_mod(const mpz_t d, const mpz_t pq, int reps) {
+    mpz_t base, out;
+    mpz_inits(base, out, NULL);
+    rand_urandomm(base, pq);
+
+    double start = now();
+    for (int i = 0; i < reps; i += 1) {
+        backend->pow_mod(out, base, d, pq);
+    }
+    double elapsed = now() - start;
+
+    mpz_clears(base, out, NULL);
+    return elapsed;
+}
+
+// times ss_reencrypt_file from the key to itself on the encrypted sample
+static double time_reencrypt(const char *cipher, size_t len, const mpz_t n, const mpz_t d,
+    const mpz_t pq, uint64_t threads) {
+    char *in_buf, *out_buf;
+    FILE *infile = sample_file(cipher, len, &in_buf);
+    FILE *outfile = sample_file(NULL, 0, &out_buf);
+
+    double start = now();
+    ss_reencrypt_file(infile, outfile, d, pq, n, threads);
+    fflush(outfile);
+    double elapsed = now() - start;
+
+    fclose(infile);
+    fclose(outfile);
+    free(in_buf);
+    free(out_buf);
+    return elapsed;
+}
+
+// runs the calibration passes for one key size and returns its profile entry
+static Profile tune_size(uint64_t bits, bool verbose) {
+    profile = (Profile) { bits, 0, 0, 4, 64, 0, 0 };
+    uint64_t cpus = profile_threads();
+
+    // a throwaway key pair of this size
+    mpz_t p, q, n, d, pq;
+    mpz_inits(p, q, n, d, pq, NULL);
+    ss_make_pub(p, q, n, bits, 20);
+    ss_make_priv(d, pq, p, q);
+
+    // encrypt selects by the width of n and decrypt by the narrower pq, so the entry records
+    // the moduli measured here next to the nominal size keygen selects by
+    profile.n_bits = mpz_sizeinbase(n, 2);
+    profile.pq_bits = mpz_sizeinbase(pq, 2);
+
+    // random plaintext covering SAMPLE_BLOCKS blocks of the file format
+    size_t k = (mpz_sizeinbase(n, 2) / 2 - 1) / 8;
+    size_t plain_len = SAMPLE_BLOCKS * (k - 1);
+    char *plain = (char *) malloc(plain_len);
+    for (size_t i = 0; i < plain_len; i += 1) {
+        plain[i] = (char) rand_u64();
+    }
+
+    // window: cost of pow_mod plus the file path
+    double best = -1;
+    uint64_t best_window = profile.window;
+    for (uint64_t w = 1; w <= PROFILE_MAX_WINDOW; w += 1) {
+        profile.window = w;
+        double files = time_files(plain, plain_len, n, d, pq);
+        double t = time_pow_mod(d, pq, 4) + files;
+        if (verbose) {
+            printf("  %lu bits: window %lu: %.4fs\n", bits, w, t);
+        }
+        if (files >= 0 && (best < 0 || t < best)) {
+            best = t;
+            best_window = w;
+        }
+    }
+    profile.window = best_window;
+
+    // chunk is not measured: a sample large enough for the buffer size to show over the
+    // exponentiations would take minutes per key size, so the stdio default is kept
+
+    // ciphertext for the threaded passes, enough blocks to give every CPU work
+    size_t big_len = (cpus > 4 ? cpus : 4) * SAMPLE_BLOCKS * (k - 1);
+    char *big = (char *) malloc(big_len);
+    for (size_t i = 0; i < big_len; i += 1) {
+        big[i] = (char) rand_u64();
+    }
+    char *ct_buf;
+    char *cipher;
+    size_t cipher_len;
+    FILE *infile = sample_file(big, big_len, &ct_buf);
+    FILE *ctfile = open_memstream(&cipher, &cipher_len);
+    ss_encrypt_file(infile, ctfile, n, NULL);
+    fclose(ctfile);
+    fclose(infile);
+    free(ct_buf);
+
+    // threads: powers of two up to the number of online CPUs
+    best = -1;
+    uint64_t best_threads = 1;
+    for (uint64_t t = 1; t <= cpus; t = t * 2 > cpus && t < cpus ? cpus : t * 2) {
+        double elapsed = time_reencrypt(cipher, cipher_len, n, d, pq, t);
+        if (verbose) {
+            printf("  %lu bits: threads %lu: %.4fs\n", bits, t, elapsed);
+        }
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+            best_threads = t;
+        }
+    }
+    profile.threads = best_threads;
+
+    // batch: blocks handed to each thread at a time
+    best = -1;
+    uint64_t best_batch = profile.batch;
+    for (size_t i = 0; i < sizeof(batches) / sizeof(batches[0]); i += 1) {
+        profile.batch = batches[i];
+        double elapsed = time_reencrypt(cipher, cipher_len, n, d, pq, profile.threads);
+        if (verbose) {
+            printf("  %lu bits: batch %lu: %.4fs\n", bits, batches[i], elapsed);
+        }
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+            best_batch = batches[i];
+        }
+    }
+    profile.batch = best_batch;
+
+    free(plain);
+    free(big);
+    free(cipher);
+    mpz_clears(p, q, n, d, pq, NULL);
+    return profile;
+}
+
+int main(int argc, char **argv) {
+    int opt = 0;
+    uint64_t bits = 0;
+    uint64_t seed = time(NULL);
+    char *profile_file = NULL;
+    char *backend_name = NULL;
+    bool verbose_flag = false;
+
+    while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+        switch (opt) {
+        case 'b': bits = strtoul(optarg, NULL, 10); break;
+        case 'o': profile_file = optarg; break;
+        case 's': seed = strtoul(optarg, NULL, 10); break;
+        case 'B': backend_name = optarg; break;
+        case 'v': verbose_flag = true; break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return 0;
+        }
+    }
+
+    // measure the backend the tools will run with, -B overrides $SS_BACKEND
+    if (!backend_select(backend_name)) {
+        fprintf(stderr, "ERROR UNKNOWN BACKEND, CHOOSE ONE OF: ");
+        backend_list(stderr);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    // Initialize the random state
+    randstate_init(seed);
+
+    // tune the requested size or all the standard ones
+    Profile entries[sizeof(key_sizes) / sizeof(key_sizes[0])];
+    size_t count = 0;
+    if (bits > 0) {
+        entries[count] = tune_size(bits, verbose_flag);
+        count += 1;
+    } else {
+        for (size_t i = 0; i < sizeof(key_sizes) / sizeof(key_sizes[0]); i += 1) {
+            entries[count] = tune_size(key_sizes[i], verbose_flag);
+            count += 1;
+        }
+    }
+
+    for (size_t i = 0; i < count; i += 1) {
+        printf("%lu bits (n %lu, pq %lu): window = %lu, batch = %lu, threads = %lu, chunk = %lu\n",
+            entries[i].bits, entries[i].n_bits, entries[i].pq_bits, entries[i].window,
+            entries[i].batch, entries[i].threads, entries[i].chunk);
+    }
+
+    // write the profile
+    if (!profile_save(profile_file, entries, count)) {
+        fprintf(stderr, "ERROR PROFILE CANNOT BE WRITTEN.\n");
+        randstate_clear();
+        return 1;
+    }
+
+    // clear all variables
+    randstate_clear();
+    arena_clear();
+
+    // terminate the program
+    return 0;
+}